@@ -0,0 +1,91 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRCHAN_H
+#define AVRCHAN_H
+
+#ifdef __AVR__
+
+/* Channel definition. The items are kept in a ring buffer provided by
+ * the caller. */
+typedef struct avr_chan_t_ {
+    uint8_t *bufp;
+    size_t capacity; /* in items */
+    size_t elem_size; /* in bytes */
+    size_t head; /* the index of the oldest item */
+    size_t count; /* the number of items in the buffer */
+    char closed;
+} avr_chan_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement bounded channels between coroutines on
+top of the coroutines facility. A channel passes fixed size items
+through a ring buffer, so the coroutine on the sending side runs until
+the buffer gets full, and the coroutine on the receiving side runs
+until it gets empty. Unlike passing items via avr_coro_resume() and
+avr_coro_yield() one by one, this takes a context switch per buffer
+instead of a context switch per item.
+
+A channel is represented by the "avr_chan_t" data type. It should be
+treated as an opaque data type.
+
+The blocking functions accept the currently running coroutine as the
+"self" argument. When they need to wait, they call avr_coro_yield()
+passing the "NULL" value as data, and check the channel again after
+the invoker resumes the coroutine. Thus, the invoker is supposed to
+resume the coroutines on both ends of the channel in turn (see the
+Channels example). When "self" is "NULL" (e.g. the invoker itself
+uses the channel), the functions do not block and move only the items
+which can be moved immediately.
+
+The function avr_chan_init() initialises a channel represented by a
+structure pointed at by "chan" on top of the memory region "bufp"
+which should be able to hold "capacity" items of "elem_size" bytes
+each. It returns 0 on success or 1 on failure.
+
+The function avr_chan_send() copies "count" items from the memory
+region pointed at by "itemsp" into the channel, waiting for room
+whenever the buffer gets full. It returns the number of the items sent,
+which is less than "count" only if the channel is closed or "self" is
+"NULL".
+
+The function avr_chan_recv() waits while the channel is empty and then
+copies as many items as available, up to "count", into the memory
+region pointed at by "itemsp". It returns the number of the items
+received: zero means that the channel is closed and empty (or that
+"self" is "NULL" and the channel is empty).
+
+The function avr_chan_close() closes a channel: the items already in
+the buffer can still be received, but no more items can be sent. It
+returns 0 on success or 1 on failure.
+
+The functions avr_chan_count() and avr_chan_space() return the number
+of the items in the buffer and the number of the items which could be
+sent without waiting.
+
+The channels are not protected against concurrent access, so they MUST
+NOT be used from within interrupt routines.
+*/
+extern int avr_chan_init(avr_chan_t *chan,
+                         void *bufp, const size_t capacity,
+                         const size_t elem_size);
+extern size_t avr_chan_send(avr_chan_t *chan, avr_coro_t *self,
+                            const void *itemsp, size_t count);
+extern size_t avr_chan_recv(avr_chan_t *chan, avr_coro_t *self,
+                            void *itemsp, size_t count);
+extern int avr_chan_close(avr_chan_t *chan);
+extern size_t avr_chan_count(const avr_chan_t *chan);
+extern size_t avr_chan_space(const avr_chan_t *chan);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+#endif /* __AVR__ */
+#endif /* AVRCHAN_H */
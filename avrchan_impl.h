@@ -0,0 +1,165 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the channel functions.
+It meant to be included after 'avrchan.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRCHAN_IMPL_H
+#define AVRCHAN_IMPL_H
+
+#ifdef __AVR__
+
+static void avr_chan_copy(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    while (size-- > 0)
+    {
+        *dst++ = *src++;
+    }
+}
+
+/* Copy up to 'count' items into the buffer, return the number of the items copied. */
+static size_t avr_chan_put(avr_chan_t *chan, const uint8_t *itemsp, size_t count)
+{
+    size_t tail, chunk, done = 0;
+    if (count > chan->capacity - chan->count)
+    {
+        count = chan->capacity - chan->count;
+    }
+    /* at most two contiguous chunks: up to the end of the buffer and from its beginning */
+    while (done < count)
+    {
+        tail = chan->head + chan->count;
+        if (tail >= chan->capacity)
+        {
+            tail -= chan->capacity;
+        }
+        chunk = chan->capacity - tail;
+        if (chunk > count - done)
+        {
+            chunk = count - done;
+        }
+        avr_chan_copy(chan->bufp + tail * chan->elem_size,
+                      itemsp + done * chan->elem_size,
+                      chunk * chan->elem_size);
+        chan->count += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+/* Copy up to 'count' items out of the buffer, return the number of the items copied. */
+static size_t avr_chan_get(avr_chan_t *chan, uint8_t *itemsp, size_t count)
+{
+    size_t chunk, done = 0;
+    if (count > chan->count)
+    {
+        count = chan->count;
+    }
+    while (done < count)
+    {
+        chunk = chan->capacity - chan->head;
+        if (chunk > count - done)
+        {
+            chunk = count - done;
+        }
+        avr_chan_copy(itemsp + done * chan->elem_size,
+                      chan->bufp + chan->head * chan->elem_size,
+                      chunk * chan->elem_size);
+        chan->head += chunk;
+        if (chan->head == chan->capacity)
+        {
+            chan->head = 0;
+        }
+        chan->count -= chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+int avr_chan_init(avr_chan_t *chan,
+                  void *bufp, const size_t capacity,
+                  const size_t elem_size)
+{
+    if (chan == NULL || bufp == NULL || capacity == 0 || elem_size == 0)
+    {
+        return 1;
+    }
+    chan->bufp = (uint8_t *)bufp;
+    chan->capacity = capacity;
+    chan->elem_size = elem_size;
+    chan->head = 0;
+    chan->count = 0;
+    chan->closed = 0;
+    return 0;
+}
+
+size_t avr_chan_send(avr_chan_t *chan, avr_coro_t *self,
+                     const void *itemsp, size_t count)
+{
+    const uint8_t *p = (const uint8_t *)itemsp;
+    size_t sent = 0;
+    if (chan == NULL || itemsp == NULL)
+    {
+        return 0;
+    }
+    while (!chan->closed)
+    {
+        sent += avr_chan_put(chan, p + sent * chan->elem_size, count - sent);
+        if (sent == count || self == NULL)
+        {
+            break;
+        }
+        /* the buffer is full, let the receiver run */
+        avr_coro_yield(self, NULL);
+    }
+    return sent;
+}
+
+size_t avr_chan_recv(avr_chan_t *chan, avr_coro_t *self,
+                     void *itemsp, size_t count)
+{
+    if (chan == NULL || itemsp == NULL || count == 0)
+    {
+        return 0;
+    }
+    while (chan->count == 0)
+    {
+        if (chan->closed || self == NULL)
+        {
+            return 0;
+        }
+        /* the buffer is empty, let the sender run */
+        avr_coro_yield(self, NULL);
+    }
+    return avr_chan_get(chan, (uint8_t *)itemsp, count);
+}
+
+int avr_chan_close(avr_chan_t *chan)
+{
+    if (chan == NULL)
+    {
+        return 1;
+    }
+    chan->closed = 1;
+    return 0;
+}
+
+size_t avr_chan_count(const avr_chan_t *chan)
+{
+    return chan == NULL ? 0 : chan->count;
+}
+
+size_t avr_chan_space(const avr_chan_t *chan)
+{
+    return chan == NULL || chan->closed ? 0 : chan->capacity - chan->count;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRCHAN_IMPL_H */
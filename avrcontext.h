@@ -10,6 +10,180 @@
 
 #ifdef __AVR__
 
+/*
+Stack painting configuration. The macros below may be defined before
+including this file (consistently across the project):
+
+AVR_CONTEXT_STACK_PAINT - when non-zero, the functions which prepare a
+context on a new stack (avr_makecontext(), avr_initcontext(),
+avr_coop_makecontext(), avr_stack_makecontext(), and, thus,
+avr_coro_init()) paint the stack with AVR_CONTEXT_STACK_PATTERN first,
+so that its peak usage could be measured later. Disabled by default.
+
+AVR_CONTEXT_STACK_PATTERN - the byte value used for painting, 0xA5 by
+default.
+*/
+#ifndef AVR_CONTEXT_STACK_PAINT
+#define AVR_CONTEXT_STACK_PAINT 0
+#endif /* AVR_CONTEXT_STACK_PAINT */
+
+#ifndef AVR_CONTEXT_STACK_PATTERN
+#define AVR_CONTEXT_STACK_PATTERN 0xA5
+#endif /* AVR_CONTEXT_STACK_PATTERN */
+
+/*
+Stack overflow detection configuration. The macros below may be
+defined before including this file (consistently across the project):
+
+AVR_CONTEXT_STACK_CANARY - when non-zero, the functions which prepare
+a context on a new stack write a guard word (the canary) at the low
+end of the stack, and the coroutines and the task scheduler check it
+whenever they switch away from a context (see avr_stack_guard() and
+AVR_STACK_CHECK below). Disabled by default.
+
+AVR_CONTEXT_STACK_CANARY_VALUE - the value of the guard word, 0x5AC3
+by default.
+*/
+#ifndef AVR_CONTEXT_STACK_CANARY
+#define AVR_CONTEXT_STACK_CANARY 0
+#endif /* AVR_CONTEXT_STACK_CANARY */
+
+#ifndef AVR_CONTEXT_STACK_CANARY_VALUE
+#define AVR_CONTEXT_STACK_CANARY_VALUE 0x5AC3
+#endif /* AVR_CONTEXT_STACK_CANARY_VALUE */
+
+/*
+Accounting configuration. The macros below may be defined before
+including this file (consistently across the project):
+
+AVR_CONTEXT_STATS - when non-zero, the coroutines and the tasks keep
+the accounting statistics (see avr_stats_switch() below): the time
+they have been running for and the number of their activations.
+Disabled by default.
+
+AVR_CONTEXT_STATS_CLOCK() - an expression which reads a free-running
+16-bit counter, TCNT1 on the classic AVR devices and TCB1.CNT on the
+megaAVR ones by default. The application is responsible for
+configuring the timer. As the elapsed time gets computed modulo
+65536, a context MUST stay active for fewer than 65536 clock ticks at
+a time (otherwise, the whole periods get lost), so please choose the
+prescaler accordingly.
+*/
+#ifndef AVR_CONTEXT_STATS
+#define AVR_CONTEXT_STATS 0
+#endif /* AVR_CONTEXT_STATS */
+
+#ifndef AVR_CONTEXT_STATS_CLOCK
+#if defined(TCNT1)
+#define AVR_CONTEXT_STATS_CLOCK() TCNT1
+#elif defined(TCB1)
+#define AVR_CONTEXT_STATS_CLOCK() TCB1.CNT
+#endif
+#endif /* AVR_CONTEXT_STATS_CLOCK */
+
+#if AVR_CONTEXT_STATS && !defined(AVR_CONTEXT_STATS_CLOCK)
+#error "Please define AVR_CONTEXT_STATS_CLOCK()."
+#endif
+
+/*
+Error recovery configuration. The macro below may be defined before
+including this file (consistently across the project):
+
+AVR_CONTEXT_TRY - when non-zero, every coroutine and every task keeps
+its own chain of protected regions (see avr_try() below), which gets
+switched along with the context, so that an error thrown within one of
+them never unwinds into a region entered by another one. It costs a
+few cycles per switch. Disabled by default: then there is only one
+chain, and a protected region MUST NOT be left by switching the
+context (e.g. by yielding from within it).
+*/
+#ifndef AVR_CONTEXT_TRY
+#define AVR_CONTEXT_TRY 0
+#endif /* AVR_CONTEXT_TRY */
+
+/*
+Large devices configuration.
+
+AVR_CONTEXT_3_BYTE_PC - non-zero on the devices with more than 128 KB
+of program memory (e.g. ATmega2560/2561), which push 3-byte return
+addresses. It is defined by this file according to the target device
+and MUST NOT be defined by the user. On such devices, the contexts get
+an extra byte which holds bits 16-21 of the program counter.
+
+The macros below may be defined before including this file
+(consistently across the project):
+
+AVR_CONTEXT_SAVE_RAMPZ - when non-zero, the full contexts
+(avr_context_t, the stack-resident contexts) keep the RAMPZ register,
+which the compiled code uses to read the program memory above 64 KB.
+Enabled by default on the devices which have RAMPZ.
+
+AVR_CONTEXT_SAVE_EIND - when non-zero, the full contexts keep the EIND
+register, which is used by the indirect jumps and calls above 128 KB.
+Enabled by default on the devices which have EIND.
+
+The compact contexts (avr_coop_context_t) keep neither of them: the
+compiled code does not expect RAMPZ to survive a call, and it never
+changes EIND.
+
+All of them are zero on the smaller devices, so the contexts and the
+context switching code stay exactly the same there.
+*/
+#if defined(__AVR_3_BYTE_PC__)
+#define AVR_CONTEXT_3_BYTE_PC 1
+#else
+#define AVR_CONTEXT_3_BYTE_PC 0
+#endif /* __AVR_3_BYTE_PC__ */
+
+#ifndef AVR_CONTEXT_SAVE_RAMPZ
+#if defined(__AVR_HAVE_RAMPZ__)
+#define AVR_CONTEXT_SAVE_RAMPZ 1
+#else
+#define AVR_CONTEXT_SAVE_RAMPZ 0
+#endif
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+
+#ifndef AVR_CONTEXT_SAVE_EIND
+#if defined(__AVR_HAVE_EIJMP_EICALL__)
+#define AVR_CONTEXT_SAVE_EIND 1
+#else
+#define AVR_CONTEXT_SAVE_EIND 0
+#endif
+#endif /* AVR_CONTEXT_SAVE_EIND */
+
+/*
+CPU core configuration.
+
+AVR_CONTEXT_AVRXT - non-zero on the devices built around the AVRxt CPU
+core (megaAVR 0-series, e.g. ATmega4809, tinyAVR 0/1/2-series, AVR
+Dx), zero on the classic ones. It is defined by this file according to
+the target device and MUST NOT be defined by the user.
+
+The context switching code gets arranged slightly differently for the
+AVRxt core:
+
+- A write to SPL disables interrupts until the next I/O write (for up
+  to four instructions), so the stack pointer gets written SPL first
+  and there is no need to disable interrupts around the write. The
+  classic core needs SREG to be saved, cleared and restored instead.
+
+- PUSH, ST and STD take a single cycle instead of two (POP, LD and LDD
+  still take two), so saving a context gets considerably cheaper than
+  restoring it.
+
+The CCP register does not need to be a part of a context: the
+interrupts are ignored during the protected sequence which follows a
+write to it, so no context switch could happen in the middle of it.
+
+The AVRxm core of the XMEGA devices shares all of the above, so it
+gets treated the same way.
+*/
+#if defined(__AVR_XMEGA__)
+#define AVR_CONTEXT_AVRXT 1
+#else
+#define AVR_CONTEXT_AVRXT 0
+#endif /* __AVR_XMEGA__ */
+
 /* AVR machine context definition. Please keep the corresponding
  * routines/macros synchronised with this definition. */
 typedef struct avr_context_t_ {
@@ -29,10 +203,123 @@ typedef struct avr_context_t_ {
         } part;
         void *ptr;
     } sp;
+#if AVR_CONTEXT_3_BYTE_PC
+    uint8_t pc_ext; /* bits 16-21 of the program counter */
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+#if AVR_CONTEXT_SAVE_RAMPZ
+    uint8_t rampz;
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+#if AVR_CONTEXT_SAVE_EIND
+    uint8_t eind;
+#endif /* AVR_CONTEXT_SAVE_EIND */
 } avr_context_t;
 
+/* Compact cooperative context definition. It holds only the registers
+ * which survive a function call (R2-R17, R28, R29, in this order), the
+ * program counter and the stack pointer. Please keep the corresponding
+ * routines synchronised with this definition. */
+typedef struct avr_coop_context_t_ {
+    uint8_t r[18];
+    union {
+        struct {
+            uint8_t low;
+            uint8_t high;
+        } part;
+        void *ptr;
+    } pc;
+    union {
+        struct {
+            uint8_t low;
+            uint8_t high;
+        } part;
+        void *ptr;
+    } sp;
+#if AVR_CONTEXT_3_BYTE_PC
+    uint8_t pc_ext; /* bits 16-21 of the program counter */
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+} avr_coop_context_t;
+
+/* Stack-resident context definition. The registers of the context reside
+ * on its own stack, so only the stack pointer gets kept here. */
+typedef struct avr_stack_context_t_ {
+    union {
+        struct {
+            uint8_t low;
+            uint8_t high;
+        } part;
+        void *ptr;
+    } sp;
+} avr_stack_context_t;
+
 typedef void (*avr_context_func_t)(void *);
 
+/* Fixed-block stack pool definition. The free blocks are linked
+ * through their first bytes, so no memory besides the arena is
+ * needed. */
+typedef struct avr_stack_pool_t_ {
+    void *free;
+    size_t block_size;
+} avr_stack_pool_t;
+
+/* Stack overflow handler type (see avr_stack_set_overflow_handler()). */
+typedef void (*avr_stack_overflow_handler_t)(const void *stackp);
+
+/* Check the guard word of the stack which starts at 'stackp' and call
+ * avr_stack_overflow() if it has been overwritten. It takes a handful
+ * of cycles, and expands to nothing when the overflow detection is
+ * disabled. */
+#if AVR_CONTEXT_STACK_CANARY
+#define AVR_STACK_CHECK(stackp)                                         \
+    do {                                                                \
+        if (*(const uint16_t *)(const void *)(stackp) !=                \
+            (uint16_t)AVR_CONTEXT_STACK_CANARY_VALUE)                   \
+        {                                                               \
+            avr_stack_overflow((stackp));                               \
+        }                                                               \
+    } while (0)
+#else
+#define AVR_STACK_CHECK(stackp) ((void)0)
+#endif /* AVR_CONTEXT_STACK_CANARY */
+
+/* Accounting statistics of a context. The clock values are measured
+ * in the AVR_CONTEXT_STATS_CLOCK() counter ticks. */
+typedef struct avr_stats_t_ {
+    uint32_t cycles; /* the time spent running */
+    uint16_t switches; /* the number of activations (wraps around) */
+    uint16_t since; /* the clock value of the last activation */
+} avr_stats_t;
+
+/* Record a switch between two contexts (see avr_stats_switch()). It
+ * expands to nothing when the accounting is disabled, so the switching
+ * code could use it unconditionally. */
+#if AVR_CONTEXT_STATS
+#define AVR_STATS_SWITCH(from, to) avr_stats_switch((from), (to))
+#else
+#define AVR_STATS_SWITCH(from, to) ((void)0)
+#endif /* AVR_CONTEXT_STATS */
+
+/* Protected region frame (see avr_try() below). The frames of the
+ * nested regions get linked from the innermost one. */
+typedef struct avr_try_t_ {
+    avr_coop_context_t ctx;
+    struct avr_try_t_ *prev;
+} avr_try_t;
+
+/* Exchange the chain of protected regions of the running context with
+ * the one pointed at by 'chain' (an lvalue of type avr_try_t *). The
+ * switching code calls it on every switch, so that every context keeps
+ * its own chain. It expands to nothing when AVR_CONTEXT_TRY is zero. */
+#if AVR_CONTEXT_TRY
+#define AVR_TRY_SWAP(chain)                                             \
+    do {                                                                \
+        avr_try_t *avr_try_chain_ = avr_try_top;                        \
+        avr_try_top = (chain);                                          \
+        (chain) = avr_try_chain_;                                       \
+    } while (0)
+#else
+#define AVR_TRY_SWAP(chain) ((void)0)
+#endif /* AVR_CONTEXT_TRY */
+
 #ifdef __cplusplus
 extern "C" {
 #endif /*__cplusplus */
@@ -102,19 +389,267 @@ to by 'cp.'
 Before invoking the avr_makecontext(), the caller must allocate a new
 stack for the modifiable context and pass pointer to it (stackp) and
 the size of the memory region (stack_size).
+
+The function avr_initcontext() initialises the context pointed to by
+'cp' in the same way as avr_makecontext() does, but it does not
+require the context to be obtained by avr_getcontext() beforehand: all
+of the registers which are not used to pass the arguments are zeroed,
+and the status register gets cleared, apart from the interrupt flag,
+which gets set if 'interrupts' is non-zero. Thus, the initial state of
+the context does not depend on the state of the caller, and the
+register dump of avr_getcontext() is not needed.
+*/
+/*
+The function avr_swapcontext_coop() is a cheaper version of
+avr_swapcontext() meant for cooperative switching (e.g. coroutines).
+
+As it is always called as a normal function, it saves only the
+registers the avr-gcc ABI requires to survive a call: R2-R17, R28,
+R29, the stack pointer and the return address. SREG gets stored too,
+and R1 gets stored as zero, so the saved context remains valid for
+avr_setcontext() and avr_swapcontext().
+
+When activating the context pointed to by 'cp', only the registers
+mentioned above get restored. The interrupt flag is left as it is at
+the moment of the call. Thus, the context pointed to by 'cp' MUST have
+been obtained at a function call boundary: by avr_getcontext(),
+avr_swapcontext(), avr_swapcontext_coop() or avr_makecontext(). A
+context saved by AVR_SAVE_CONTEXT from within an interrupt routine
+MUST NOT be activated by this function.
 */
 extern void avr_getcontext(avr_context_t *cp);
 extern void avr_setcontext(const avr_context_t *cp);
 extern void avr_swapcontext(avr_context_t *oucp, const avr_context_t *cp);
+extern void avr_swapcontext_coop(avr_context_t *oucp, const avr_context_t *cp);
+
+/*
+The four functions avr_coop_getcontext(), avr_coop_setcontext(),
+avr_coop_swapcontext(), and avr_coop_makecontext() are the
+counterparts of the functions above which work on the compact
+cooperative context (avr_coop_context_t). The structure is 22 bytes
+long instead of 37, which makes it a better fit for the cases when
+many contexts are needed (e.g. coroutines).
+
+The functions behave like avr_swapcontext_coop(): only the registers
+which survive a function call, the stack pointer and the program
+counter get saved and restored. The interrupt flag is left as it is at
+the moment of the call. Thus, the compact contexts are only useful for
+cooperative switching, please use avr_context_t when switching from
+within interrupt routines.
+
+The function avr_coop_makecontext() follows the rules of
+avr_makecontext(), but the successor context is a compact one. As a
+compact context has no status register to inherit, the function sets
+every field the activation needs: the context does not have to be
+obtained by avr_coop_getcontext() beforehand.
+
+The functions avr_coop_swapcontext_data() and avr_coop_setcontext_data()
+are the counterparts of avr_coop_swapcontext() and avr_coop_setcontext()
+which pass a pointer-sized value "data" to the activated context in
+registers: when the context has been saved by
+avr_coop_swapcontext_data(), the value gets returned by that call. This
+way two contexts can exchange data without storing it in memory.
+*/
+extern void avr_coop_getcontext(avr_coop_context_t *cp);
+extern void avr_coop_setcontext(const avr_coop_context_t *cp);
+extern void avr_coop_swapcontext(avr_coop_context_t *oucp, const avr_coop_context_t *cp);
+extern void *avr_coop_swapcontext_data(avr_coop_context_t *oucp, const avr_coop_context_t *cp, void *data);
+extern void avr_coop_setcontext_data(const avr_coop_context_t *cp, void *data);
+extern void avr_coop_makecontext(avr_coop_context_t *cp,
+                                 void *stackp, const size_t stack_size,
+                                 const avr_coop_context_t *successor_cp,
+                                 avr_context_func_t funcp, void *funcargp);
+
+/*
+The function avr_stack_makecontext() prepares a stack-resident context
+(see AVR_SAVE_CONTEXT_STACK and AVR_RESTORE_CONTEXT_STACK below) in
+such a way that upon activation by AVR_RESTORE_CONTEXT_STACK the
+function 'funcp' gets called with the 'funcargp' value passed as its
+argument. When this function returns, the successor context
+'successor_cp' gets activated by avr_setcontext().
+
+The initial register values get pushed onto the stack (stackp,
+stack_size), thus, unlike avr_makecontext(), the function does not
+require a previously obtained context. All of the registers which are
+not used to pass the arguments are zeroed. The interrupts get enabled
+by the 'reti' instruction executed right after the context
+restoration.
+*/
+extern void avr_stack_makecontext(avr_stack_context_t *cp,
+                                  void *stackp, const size_t stack_size,
+                                  const avr_context_t *successor_cp,
+                                  avr_context_func_t funcp, void *funcargp);
 extern void avr_makecontext(avr_context_t *cp,
                             void *stackp, const size_t stack_size,
                             const avr_context_t *successor_cp,
                             avr_context_func_t funcp, void *funcargp);
+extern void avr_initcontext(avr_context_t *cp,
+                            void *stackp, const size_t stack_size,
+                            const avr_context_t *successor_cp,
+                            avr_context_func_t funcp, void *funcargp,
+                            uint8_t interrupts);
+
+/*
+The functions avr_stack_paint() and avr_stack_used() make it possible
+to measure the peak usage (the high-water mark) of a stack.
+
+The function avr_stack_paint() fills the stack (stackp, stack_size)
+with the AVR_CONTEXT_STACK_PATTERN value. It should be called before
+the stack gets passed to one of the functions above (unless the
+painting is done by them, see AVR_CONTEXT_STACK_PAINT), and MUST NOT
+be called on a stack which is in use.
+
+The function avr_stack_used() returns the number of bytes of a painted
+stack which have been used so far. As the stack grows downwards, it
+counts the bytes from the beginning of the memory region which still
+hold the pattern. The result is exact unless the deepest used bytes
+happen to hold the pattern value itself.
+*/
+extern void avr_stack_paint(void *stackp, const size_t stack_size);
+extern size_t avr_stack_used(const void *stackp, const size_t stack_size);
+
+/*
+The functions below implement the stack overflow detection.
+
+The function avr_stack_guard() writes the guard word
+(AVR_CONTEXT_STACK_CANARY_VALUE) at the low end of the stack which
+starts at "stackp". The functions which prepare a context on a new
+stack call it when AVR_CONTEXT_STACK_CANARY is non-zero. The stack
+should be at least two bytes long. The guard word is treated as unused
+by avr_stack_used().
+
+The function avr_stack_check() returns 0 if the guard word of the
+stack which starts at "stackp" is intact, or 1 otherwise. The
+AVR_STACK_CHECK macro is its inlined counterpart, it calls
+avr_stack_overflow() when the check fails.
+
+The function avr_stack_overflow() calls the handler set by
+avr_stack_set_overflow_handler() passing "stackp" to it. When there is
+no handler, it halts the MCU: it disables interrupts and loops
+forever. If the handler returns, the execution continues, although the
+memory next to the stack may have been corrupted already.
+*/
+extern void avr_stack_guard(void *stackp);
+extern int avr_stack_check(const void *stackp);
+extern void avr_stack_overflow(const void *stackp);
+extern void avr_stack_set_overflow_handler(avr_stack_overflow_handler_t handler);
+
+/*
+The functions avr_stack_pool_init(), avr_stack_pool_acquire(), and
+avr_stack_pool_release() implement a fixed-block allocator of stacks.
+
+The function avr_stack_pool_init() carves the memory region (arenap,
+arena_size) into blocks of "block_size" bytes each (the remainder, if
+any, is left unused) and puts them into the pool pointed at by "pool."
+The block size should be at least the size of a pointer. It returns 0
+on success or 1 on failure.
+
+The function avr_stack_pool_acquire() takes a block from the pool and
+returns a pointer to it, or "NULL" if the pool is exhausted. The
+function avr_stack_pool_release() returns the block pointed at by
+"stackp" back to the pool. It returns 0 on success or 1 on failure.
+Both of the functions work in constant time.
+
+The pool is not protected against concurrent access: please do not
+share a pool between interrupt routines or preemptively scheduled
+tasks without disabling interrupts around the calls.
+*/
+extern int avr_stack_pool_init(avr_stack_pool_t *pool,
+                               void *arenap, const size_t arena_size,
+                               const size_t block_size);
+extern void *avr_stack_pool_acquire(avr_stack_pool_t *pool);
+extern int avr_stack_pool_release(avr_stack_pool_t *pool, void *stackp);
+
+/*
+The functions below are available only when the accounting is enabled
+(see AVR_CONTEXT_STATS above).
+
+The function avr_stats_switch() records a switch from the context
+which statistics are pointed at by "from" to the one which statistics
+are pointed at by "to": the time since the activation of the former
+gets added to its "cycles", the latter gets its activation counted.
+Either of the pointers may be "NULL". The coroutines and the task
+scheduler call it on every switch (via AVR_STATS_SWITCH). The
+interrupt routines which switch contexts on their own (see
+AVR_SAVE_CONTEXT and AVR_RESTORE_CONTEXT below) may call it between
+saving and restoring the contexts. It MUST be called with interrupts
+disabled when the same statistics could be updated from within an
+interrupt routine.
+
+The function avr_stats_read() copies the statistics pointed at by
+"stats" into "snapshot" with interrupts disabled, so that the copy is
+consistent even when the statistics get updated from within an
+interrupt routine. The function avr_stats_reset() zeroes the
+statistics (the activation time is kept). Both of them return 0 on
+success or 1 on failure.
+*/
+#if AVR_CONTEXT_STATS
+extern void avr_stats_switch(avr_stats_t *from, avr_stats_t *to);
+extern int avr_stats_read(const avr_stats_t *stats, avr_stats_t *snapshot);
+extern int avr_stats_reset(avr_stats_t *stats);
+#endif /* AVR_CONTEXT_STATS */
+
+/*
+The functions avr_try() and avr_throw() implement error recovery in
+the fashion of setjmp() and longjmp(), with the protected regions
+linked into a chain, so that they could be nested:
+
+avr_try_t frame;
+int error = avr_try(&frame);
+if (error == 0)
+{
+    ... avr_throw(PACKET_TOO_SHORT); ...
+    avr_try_end(&frame);
+}
+else
+{
+    ... the region has been left by avr_throw() ...
+}
+
+The function avr_try() enters a protected region: it saves the
+compact context of the caller (see avr_coop_getcontext()) into the
+frame pointed at by "frame", puts the frame on top of the chain
+(avr_try_top) and returns 0. Only the registers which survive a
+function call, the stack pointer and the program counter get saved, so
+it takes a few dozen cycles. The frame has to reside in memory until
+the region is left, e.g. on the stack of the caller.
+
+The function avr_throw() leaves the innermost protected region: it
+takes the frame off the chain and activates its context, so that the
+corresponding avr_try() call returns once again, with the "code"
+value (or 1 if it is 0). Thus, an error could be propagated to the
+enclosing region by calling avr_throw() again. When there is no
+protected region, it halts the MCU, like avr_stack_overflow() does. It
+MUST NOT be called from within interrupt routines.
+
+The function avr_try_end() leaves the protected region normally: it
+takes "frame" (which MUST be the innermost one) off the chain. Every
+region entered by avr_try() MUST be left either this way or by
+avr_throw() before the function which has called avr_try() returns.
+
+As with setjmp(), the local variables of the function which has
+called avr_try() and have been modified within the region hold
+unspecified values when avr_throw() returns there, unless they are
+declared "volatile". No cleanup gets done on the way: e.g. the
+resources acquired within the region have to be released by the code
+which handles the error.
+
+The chain gets kept per coroutine and per task only when
+AVR_CONTEXT_TRY is non-zero (see above).
+*/
+extern avr_try_t *avr_try_top;
+extern int avr_try(avr_try_t *frame) __attribute__ ((returns_twice));
+extern void avr_throw(int code) __attribute__ ((noreturn));
 
 #ifdef __cplusplus
 }
 #endif /*__cplusplus */
 
+static inline void avr_try_end(avr_try_t *frame)
+{
+    avr_try_top = frame->prev;
+}
+
 /*
 It is highly unlikely to understand the following code without:
 a) basic understanding of AVR assembly language;
@@ -126,6 +661,27 @@ b) reading about avr-gcc's ABI beforehand (https://gcc.gnu.org/wiki/avr-gcc).
 #define AVR_CONTEXT_ASMCONST(name, value)\
     __asm__(".equ " #name "," #value "\n");
 
+#define AVR_CONTEXT_OFFSET_SREG 0
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_SREG, 0)
+
+#define AVR_CONTEXT_OFFSET_R0 1
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R0, 1)
+
+#define AVR_CONTEXT_OFFSET_R1 2
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R1, 2)
+
+#define AVR_CONTEXT_OFFSET_R2 3
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R2, 3)
+
+#define AVR_CONTEXT_OFFSET_R18 19
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R18, 19)
+
+#define AVR_CONTEXT_OFFSET_R28 29
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R28, 29)
+
+#define AVR_CONTEXT_OFFSET_R30 31
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_R30, 31)
+
 #define AVR_CONTEXT_OFFSET_PC_L 33
 AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_PC_L, 33)
 
@@ -141,6 +697,176 @@ AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_SP_H, 36)
 #define AVR_CONTEXT_BACK_OFFSET_R26 9
 AVR_CONTEXT_ASMCONST(AVR_CONTEXT_BACK_OFFSET_R26, 9)
 
+/* The optional fields at the end of the context structure. */
+#if AVR_CONTEXT_3_BYTE_PC
+#define AVR_CONTEXT_OFFSET_PC_E 37
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_PC_E, 37)
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+#if AVR_CONTEXT_SAVE_RAMPZ
+#if AVR_CONTEXT_3_BYTE_PC
+#define AVR_CONTEXT_OFFSET_RAMPZ 38
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_RAMPZ, 38)
+#else
+#define AVR_CONTEXT_OFFSET_RAMPZ 37
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_RAMPZ, 37)
+#endif
+/* The I/O address of RAMPZ is the same on every device which has it. */
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_IO_RAMPZ, 0x3B)
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+
+#if AVR_CONTEXT_SAVE_EIND
+#if AVR_CONTEXT_3_BYTE_PC && AVR_CONTEXT_SAVE_RAMPZ
+#define AVR_CONTEXT_OFFSET_EIND 39
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_EIND, 39)
+#elif AVR_CONTEXT_3_BYTE_PC || AVR_CONTEXT_SAVE_RAMPZ
+#define AVR_CONTEXT_OFFSET_EIND 38
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_EIND, 38)
+#else
+#define AVR_CONTEXT_OFFSET_EIND 37
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_OFFSET_EIND, 37)
+#endif
+/* The I/O address of EIND is the same on every device which has it. */
+AVR_CONTEXT_ASMCONST(AVR_CONTEXT_IO_EIND, 0x3C)
+#endif /* AVR_CONTEXT_SAVE_EIND */
+
+/* Offsets within the compact cooperative context structure. */
+#define AVR_COOP_CONTEXT_OFFSET_R2 0
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_R2, 0)
+
+#define AVR_COOP_CONTEXT_OFFSET_R28 16
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_R28, 16)
+
+#define AVR_COOP_CONTEXT_OFFSET_PC_L 18
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_PC_L, 18)
+
+#define AVR_COOP_CONTEXT_OFFSET_PC_H 19
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_PC_H, 19)
+
+#define AVR_COOP_CONTEXT_OFFSET_SP_L 20
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_SP_L, 20)
+
+#define AVR_COOP_CONTEXT_OFFSET_SP_H 21
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_SP_H, 21)
+
+#if AVR_CONTEXT_3_BYTE_PC
+#define AVR_COOP_CONTEXT_OFFSET_PC_E 22
+AVR_CONTEXT_ASMCONST(AVR_COOP_CONTEXT_OFFSET_PC_E, 22)
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+/* Offset within the protected region frame: the link follows the
+ * context. */
+#if AVR_CONTEXT_3_BYTE_PC
+#define AVR_TRY_OFFSET_PREV 23
+AVR_CONTEXT_ASMCONST(AVR_TRY_OFFSET_PREV, 23)
+#else
+#define AVR_TRY_OFFSET_PREV 22
+AVR_CONTEXT_ASMCONST(AVR_TRY_OFFSET_PREV, 22)
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+/*
+The code fragments below get spliced into the context switching code
+to handle the optional context fields (see AVR_CONTEXT_3_BYTE_PC,
+AVR_CONTEXT_SAVE_RAMPZ, AVR_CONTEXT_SAVE_EIND above). They expand to
+nothing on the devices which do not need them.
+
+AVR_CONTEXT_IF_3_BYTE_PC(code) expands to 'code' only on the devices
+with 3-byte return addresses. The extended part of a return address
+is the first byte to pop and the last byte to push.
+
+AVR_CONTEXT_STORE_EXTRA(ptr, base, reg) stores RAMPZ and EIND into the
+context structure, and AVR_CONTEXT_LOAD_EXTRA(ptr, base, reg) loads
+them back. The pointer register 'ptr' (Y or Z) holds the address of
+the field at the offset 'base' within the structure, 'reg' gets
+clobbered.
+
+AVR_CONTEXT_PUSH_EXTRA(reg) and AVR_CONTEXT_POP_EXTRA(reg) do the same
+for the stack-resident contexts.
+*/
+#if AVR_CONTEXT_3_BYTE_PC
+#define AVR_CONTEXT_IF_3_BYTE_PC(code) code
+#else
+#define AVR_CONTEXT_IF_3_BYTE_PC(code) ""
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+#if AVR_CONTEXT_SAVE_RAMPZ
+#define AVR_CONTEXT_STORE_RAMPZ(ptr, base, reg)                         \
+    "in " reg ", AVR_CONTEXT_IO_RAMPZ\n"                                \
+    "std " ptr "+AVR_CONTEXT_OFFSET_RAMPZ-" base ", " reg "\n"
+#define AVR_CONTEXT_LOAD_RAMPZ(ptr, base, reg)                          \
+    "ldd " reg ", " ptr "+AVR_CONTEXT_OFFSET_RAMPZ-" base "\n"          \
+    "out AVR_CONTEXT_IO_RAMPZ, " reg "\n"
+#define AVR_CONTEXT_PUSH_RAMPZ(reg)                                     \
+    "in " reg ", AVR_CONTEXT_IO_RAMPZ\n"                                \
+    "push " reg "\n"
+#define AVR_CONTEXT_POP_RAMPZ(reg)                                      \
+    "pop " reg "\n"                                                     \
+    "out AVR_CONTEXT_IO_RAMPZ, " reg "\n"
+#else
+#define AVR_CONTEXT_STORE_RAMPZ(ptr, base, reg) ""
+#define AVR_CONTEXT_LOAD_RAMPZ(ptr, base, reg) ""
+#define AVR_CONTEXT_PUSH_RAMPZ(reg) ""
+#define AVR_CONTEXT_POP_RAMPZ(reg) ""
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+
+#if AVR_CONTEXT_SAVE_EIND
+#define AVR_CONTEXT_STORE_EIND(ptr, base, reg)                          \
+    "in " reg ", AVR_CONTEXT_IO_EIND\n"                                 \
+    "std " ptr "+AVR_CONTEXT_OFFSET_EIND-" base ", " reg "\n"
+#define AVR_CONTEXT_LOAD_EIND(ptr, base, reg)                           \
+    "ldd " reg ", " ptr "+AVR_CONTEXT_OFFSET_EIND-" base "\n"           \
+    "out AVR_CONTEXT_IO_EIND, " reg "\n"
+#define AVR_CONTEXT_PUSH_EIND(reg)                                      \
+    "in " reg ", AVR_CONTEXT_IO_EIND\n"                                 \
+    "push " reg "\n"
+#define AVR_CONTEXT_POP_EIND(reg)                                       \
+    "pop " reg "\n"                                                     \
+    "out AVR_CONTEXT_IO_EIND, " reg "\n"
+#else
+#define AVR_CONTEXT_STORE_EIND(ptr, base, reg) ""
+#define AVR_CONTEXT_LOAD_EIND(ptr, base, reg) ""
+#define AVR_CONTEXT_PUSH_EIND(reg) ""
+#define AVR_CONTEXT_POP_EIND(reg) ""
+#endif /* AVR_CONTEXT_SAVE_EIND */
+
+#define AVR_CONTEXT_STORE_EXTRA(ptr, base, reg)                         \
+    AVR_CONTEXT_STORE_RAMPZ(ptr, base, reg)                             \
+    AVR_CONTEXT_STORE_EIND(ptr, base, reg)
+#define AVR_CONTEXT_LOAD_EXTRA(ptr, base, reg)                          \
+    AVR_CONTEXT_LOAD_RAMPZ(ptr, base, reg)                              \
+    AVR_CONTEXT_LOAD_EIND(ptr, base, reg)
+#define AVR_CONTEXT_PUSH_EXTRA(reg)                                     \
+    AVR_CONTEXT_PUSH_RAMPZ(reg)                                         \
+    AVR_CONTEXT_PUSH_EIND(reg)
+/* in the reverse order */
+#define AVR_CONTEXT_POP_EXTRA(reg)                                      \
+    AVR_CONTEXT_POP_EIND(reg)                                           \
+    AVR_CONTEXT_POP_RAMPZ(reg)
+
+/* Write the stack pointer from the registers 'lo' and 'hi'.
+ * AVR_CONTEXT_OUT_SP expects interrupts to be disabled on the classic
+ * core, AVR_CONTEXT_OUT_SP_ATOMIC does not (it clobbers 'tmp' there).
+ * On the AVRxt core both of them are atomic (see AVR_CONTEXT_AVRXT). */
+#if AVR_CONTEXT_AVRXT
+#define AVR_CONTEXT_OUT_SP(lo, hi)                                      \
+    "out __SP_L__, " lo "\n"                                            \
+    "out __SP_H__, " hi "\n"
+#define AVR_CONTEXT_OUT_SP_ATOMIC(lo, hi, tmp)                          \
+    AVR_CONTEXT_OUT_SP(lo, hi)
+#else
+#define AVR_CONTEXT_OUT_SP(lo, hi)                                      \
+    "out __SP_H__, " hi "\n"                                            \
+    "out __SP_L__, " lo "\n"
+/* The instruction following 'out __SREG__' is always executed before
+ * any pending interrupt. */
+#define AVR_CONTEXT_OUT_SP_ATOMIC(lo, hi, tmp)                          \
+    "in " tmp ", __SREG__\n"                                            \
+    "cli\n"                                                             \
+    "out __SP_H__, " hi "\n"                                            \
+    "out __SREG__, " tmp "\n"                                           \
+    "out __SP_L__, " lo "\n"
+#endif /* AVR_CONTEXT_AVRXT */
+
 /*
 AVR_SAVE_CONTEXT and AVR_RESTORE_CONTEXT macros provide the generic
 facility for saving/restoring an AVR CPU context.
@@ -241,6 +967,9 @@ avr_getcontext()/avr_setcontext()/avr_swapcontext()/avr_makecontext().
         "st y+, r30\n"                                                  \
         "st y+, r31\n"                                                  \
         /* Pop and save the return address */                           \
+        AVR_CONTEXT_IF_3_BYTE_PC(                                       \
+            "pop r26\n" /* extended part */                             \
+            "std y+AVR_CONTEXT_OFFSET_PC_E-AVR_CONTEXT_OFFSET_PC_L, r26\n") \
         "pop r30\n" /* high part */                                     \
         "pop r31\n" /* low part */                                      \
         "st y+, r31\n"                                                  \
@@ -250,9 +979,13 @@ avr_getcontext()/avr_setcontext()/avr_swapcontext()/avr_makecontext().
         "in r27, __SP_H__\n"                                            \
         "st y+, r26\n"                                                  \
         "st y, r27\n"                                                   \
+        AVR_CONTEXT_STORE_EXTRA("y", "AVR_CONTEXT_OFFSET_SP_H", "r26")  \
         /* Push the return address back at the top of the stack. */     \
         "push r31\n" /* low part */                                     \
         "push r30\n" /* high part */                                    \
+        AVR_CONTEXT_IF_3_BYTE_PC(                                       \
+            "ldd r26, y+AVR_CONTEXT_OFFSET_PC_E-AVR_CONTEXT_OFFSET_SP_H\n" \
+            "push r26\n") /* extended part */                           \
         /* At this point the context is saved, but registers */         \
         /* 26, 27, 28, 29, 30, and 31 are clobbered. */                 \
         /* In some cases we may not need to restore them, */            \
@@ -291,15 +1024,18 @@ avr_getcontext()/avr_setcontext()/avr_swapcontext()/avr_makecontext().
         /* start restoring it from there. */                            \
         "adiw r30, AVR_CONTEXT_OFFSET_SP_H\n"                           \
         /* Restore the saved stack pointer. */                          \
-        "ld r0, Z\n"                                                    \
-        "out __SP_H__, r0\n"                                            \
+        "ld r1, Z\n"                                                    \
         "ld r0, -Z\n"                                                   \
-        "out __SP_L__, r0\n"                                            \
+        AVR_CONTEXT_OUT_SP("r0", "r1")                                  \
         /* Put the saved return address (PC) back on the top of the stack. */ \
         "ld r1, -Z\n" /* high part */                                   \
         "ld r0, -Z\n" /* low part */                                    \
         "push r0\n"                                                     \
         "push r1\n"                                                     \
+        AVR_CONTEXT_IF_3_BYTE_PC(                                       \
+            "ldd r0, Z+AVR_CONTEXT_OFFSET_PC_E-AVR_CONTEXT_OFFSET_PC_L\n" \
+            "push r0\n") /* extended part */                            \
+        AVR_CONTEXT_LOAD_EXTRA("Z", "AVR_CONTEXT_OFFSET_PC_L", "r0")    \
         /* Temporarily switch pointer from Z to Y,*/                    \
         /* restore r31, r30 (Z) and put them on top of the stack. */    \
         "mov r28, r30\n"                                                \
@@ -385,6 +1121,386 @@ work.
         "lds ZL, " #global_context_pointer "\n"                     \
         "lds ZH, " #global_context_pointer " + 1\n")
 
+/*
+AVR_SAVE_CONTEXT_STACK and AVR_RESTORE_CONTEXT_STACK macros provide
+the alternative facility for saving/restoring an AVR CPU context. The
+registers get pushed onto the stack of the interrupted thread of
+execution and only the resulting stack pointer gets stored into an
+avr_stack_context_t structure (2 bytes). This is the way most of the
+AVR RTOS ports do it. Both of the saving and the restoring code paths
+are shorter than the ones of AVR_SAVE_CONTEXT and AVR_RESTORE_CONTEXT.
+
+The macros are meant to be used in naked interrupt system routines,
+thus, they expect the return address to be on top of the stack. The
+return address remains there. Every thread of execution which gets
+switched this way needs additional 33 bytes on its stack to keep its
+context, plus one byte for each of RAMPZ and EIND when they are saved
+(see AVR_CONTEXT_SAVE_RAMPZ and AVR_CONTEXT_SAVE_EIND).
+
+The argument named 'presave_code' has the same meaning as for the
+AVR_SAVE_CONTEXT macro. The argument named 'load_address_to_Z_code'
+should be a string constant which contains assembly instructions that
+load the address of an avr_stack_context_t structure to Z. Unlike the
+AVR_SAVE_CONTEXT, it is executed after saving the registers, so it may
+clobber any of them except R26 and R27.
+
+After saving the context registers R1 (cleared), R26, R27, R30 and R31
+(Z) are clobbered. It is not a problem as the registers can be
+restored only by using AVR_RESTORE_CONTEXT_STACK. Thus, it is safe to
+call C functions after saving the context.
+
+To restore a context, AVR_RESTORE_CONTEXT_STACK loads the stack pointer
+from the avr_stack_context_t structure, which address gets loaded into
+Z by 'load_address_to_Z_code', and pops the registers. This code
+should be executed with interrupts disabled. It is expected to be
+followed by the 'reti' instruction.
+
+A context of a new thread of execution can be prepared using the
+avr_stack_makecontext() function.
+*/
+#define AVR_SAVE_CONTEXT_STACK(presave_code, load_address_to_Z_code)    \
+    __asm__ __volatile__(                                               \
+        /* Push R0 and SREG using R0 as a temporary register. */        \
+        "push r0\n"                                                     \
+        "in r0, __SREG__\n"                                             \
+        "\n" presave_code "\n"                                          \
+        "push r0\n"                                                     \
+        /* Push R1 and clear it, compiled code expects it to be zero. */ \
+        "push r1\n"                                                     \
+        "clr r1\n"                                                      \
+        /* Push other general purpose registers. */                     \
+        "push r2\n"                                                     \
+        "push r3\n"                                                     \
+        "push r4\n"                                                     \
+        "push r5\n"                                                     \
+        "push r6\n"                                                     \
+        "push r7\n"                                                     \
+        "push r8\n"                                                     \
+        "push r9\n"                                                     \
+        "push r10\n"                                                    \
+        "push r11\n"                                                    \
+        "push r12\n"                                                    \
+        "push r13\n"                                                    \
+        "push r14\n"                                                    \
+        "push r15\n"                                                    \
+        "push r16\n"                                                    \
+        "push r17\n"                                                    \
+        "push r18\n"                                                    \
+        "push r19\n"                                                    \
+        "push r20\n"                                                    \
+        "push r21\n"                                                    \
+        "push r22\n"                                                    \
+        "push r23\n"                                                    \
+        "push r24\n"                                                    \
+        "push r25\n"                                                    \
+        "push r26\n"                                                    \
+        "push r27\n"                                                    \
+        "push r28\n"                                                    \
+        "push r29\n"                                                    \
+        "push r30\n"                                                    \
+        "push r31\n"                                                    \
+        AVR_CONTEXT_PUSH_EXTRA("r26")                                   \
+        /* Store the stack pointer into the structure. */               \
+        "in r26, __SP_L__\n"                                            \
+        "in r27, __SP_H__\n"                                            \
+        "\n" load_address_to_Z_code "\n"                                \
+        "st Z+, r26\n"                                                  \
+        "st Z, r27\n")
+
+#define AVR_RESTORE_CONTEXT_STACK(load_address_to_Z_code)               \
+    __asm__ __volatile__(                                               \
+        /* Load the saved stack pointer. */                             \
+        "\n" load_address_to_Z_code "\n"                                \
+        "ld r26, Z+\n"                                                  \
+        "ld r27, Z\n"                                                   \
+        AVR_CONTEXT_OUT_SP("r26", "r27")                                \
+        AVR_CONTEXT_POP_EXTRA("r26")                                    \
+        /* Pop general purpose registers. */                            \
+        "pop r31\n"                                                     \
+        "pop r30\n"                                                     \
+        "pop r29\n"                                                     \
+        "pop r28\n"                                                     \
+        "pop r27\n"                                                     \
+        "pop r26\n"                                                     \
+        "pop r25\n"                                                     \
+        "pop r24\n"                                                     \
+        "pop r23\n"                                                     \
+        "pop r22\n"                                                     \
+        "pop r21\n"                                                     \
+        "pop r20\n"                                                     \
+        "pop r19\n"                                                     \
+        "pop r18\n"                                                     \
+        "pop r17\n"                                                     \
+        "pop r16\n"                                                     \
+        "pop r15\n"                                                     \
+        "pop r14\n"                                                     \
+        "pop r13\n"                                                     \
+        "pop r12\n"                                                     \
+        "pop r11\n"                                                     \
+        "pop r10\n"                                                     \
+        "pop r9\n"                                                      \
+        "pop r8\n"                                                      \
+        "pop r7\n"                                                      \
+        "pop r6\n"                                                      \
+        "pop r5\n"                                                      \
+        "pop r4\n"                                                      \
+        "pop r3\n"                                                      \
+        "pop r2\n"                                                      \
+        "pop r1\n"                                                      \
+        /* Restore SREG and R0. */                                      \
+        "pop r0\n"                                                      \
+        "out __SREG__, r0\n"                                            \
+        "pop r0\n")
+
+/*
+AVR_SAVE_CONTEXT_STACK_GLOBAL_POINTER and
+AVR_RESTORE_CONTEXT_STACK_GLOBAL_POINTER macros are the counterparts
+of AVR_SAVE_CONTEXT_GLOBAL_POINTER and
+AVR_RESTORE_CONTEXT_GLOBAL_POINTER: they save/restore a context
+to/from an avr_stack_context_t structure via a global pointer
+variable. The same rules apply to the pointer definition, e.g.:
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+avr_stack_context_t *volatile avr_current_stack_ctx;
+#ifdef __cplusplus
+}
+#endif
+*/
+#define AVR_SAVE_CONTEXT_STACK_GLOBAL_POINTER(presave_code, global_context_pointer) \
+    AVR_SAVE_CONTEXT_STACK(                                             \
+        presave_code,                                                   \
+        "lds ZL, "#global_context_pointer"\n"                           \
+        "lds ZH, "#global_context_pointer" + 1\n")
+
+#define AVR_RESTORE_CONTEXT_STACK_GLOBAL_POINTER(global_context_pointer) \
+    AVR_RESTORE_CONTEXT_STACK(                                          \
+        "lds ZL, " #global_context_pointer "\n"                         \
+        "lds ZH, " #global_context_pointer " + 1\n")
+
+/*
+AVR_SAVE_CONTEXT_PARTIAL, AVR_RESTORE_CONTEXT_PARTIAL and
+AVR_SAVE_CONTEXT_REST macros make it possible to switch contexts from
+an interrupt routine which does its work in ordinary C code, without
+saving the whole context on every interrupt. Like the rest of the
+macros, they are meant to be used in naked interrupt routines.
+
+AVR_SAVE_CONTEXT_PARTIAL pushes only the registers which a C function
+is allowed to clobber (R0, SREG, R1, RAMPZ if it is saved, R18-R27,
+R30, R31) onto the stack and clears R1, the same way the prologue
+generated by the compiler for an interrupt routine which calls a
+function does. After that, C functions could be called.
+AVR_RESTORE_CONTEXT_PARTIAL pops the registers back. It is expected to
+be followed by the 'reti' instruction.
+
+When the context of the interrupted code should be switched,
+AVR_SAVE_CONTEXT_REST should be used in place of
+AVR_RESTORE_CONTEXT_PARTIAL. It saves what is left: the call-saved
+registers (the called C functions have preserved the values of the
+interrupted code in them), the return address and the stack pointer
+get stored into an avr_context_t structure, and the registers pushed
+by AVR_SAVE_CONTEXT_PARTIAL get moved from the stack into it. The
+result is the same as the one of AVR_SAVE_CONTEXT, so the context
+could be restored by AVR_RESTORE_CONTEXT (or activated by e.g.
+avr_setcontext()).
+
+The argument named 'sreg_code' should be a string constant which
+contains assembly instructions which get executed with the status
+register value of the interrupted code in R18, right before storing it
+(e.g. "ori r18, 0x80\n" sets the interrupt flag in the saved value).
+The argument named 'load_address_to_Z_code' has the same meaning as
+for AVR_SAVE_CONTEXT. It may clobber R0, R18-R27 (but not R1).
+
+After saving the context R1 is zero, so it is safe to call C functions.
+The values of the other registers do not matter, as the context is
+expected to be restored by AVR_RESTORE_CONTEXT.
+*/
+#define AVR_CONTEXT_ISR_SAVE_PARTIAL                                    \
+    "push r0\n"                                                         \
+    "in r0, __SREG__\n"                                                 \
+    "push r0\n"                                                         \
+    "push r1\n"                                                         \
+    "clr r1\n"                                                          \
+    AVR_CONTEXT_PUSH_RAMPZ("r0")                                        \
+    "push r18\n"                                                        \
+    "push r19\n"                                                        \
+    "push r20\n"                                                        \
+    "push r21\n"                                                        \
+    "push r22\n"                                                        \
+    "push r23\n"                                                        \
+    "push r24\n"                                                        \
+    "push r25\n"                                                        \
+    "push r26\n"                                                        \
+    "push r27\n"                                                        \
+    "push r30\n"                                                        \
+    "push r31\n"
+
+#define AVR_CONTEXT_ISR_RESTORE_PARTIAL                                 \
+    "pop r31\n"                                                         \
+    "pop r30\n"                                                         \
+    "pop r27\n"                                                         \
+    "pop r26\n"                                                         \
+    "pop r25\n"                                                         \
+    "pop r24\n"                                                         \
+    "pop r23\n"                                                         \
+    "pop r22\n"                                                         \
+    "pop r21\n"                                                         \
+    "pop r20\n"                                                         \
+    "pop r19\n"                                                         \
+    "pop r18\n"                                                         \
+    AVR_CONTEXT_POP_RAMPZ("r0")                                         \
+    "pop r1\n"                                                          \
+    "pop r0\n"                                                          \
+    "out __SREG__, r0\n"                                                \
+    "pop r0\n"
+
+#if AVR_CONTEXT_SAVE_RAMPZ
+#define AVR_CONTEXT_IF_SAVE_RAMPZ(code) code
+#else
+#define AVR_CONTEXT_IF_SAVE_RAMPZ(code) ""
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+
+#define AVR_CONTEXT_ISR_SAVE_REST(sreg_code, load_address_to_Z_code)    \
+    "\n" load_address_to_Z_code "\n"                                    \
+    /* Save the call-saved registers, as they are. */                   \
+    "std Z+AVR_CONTEXT_OFFSET_R2+0, r2\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+1, r3\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+2, r4\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+3, r5\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+4, r6\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+5, r7\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+6, r8\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+7, r9\n"                               \
+    "std Z+AVR_CONTEXT_OFFSET_R2+8, r10\n"                              \
+    "std Z+AVR_CONTEXT_OFFSET_R2+9, r11\n"                              \
+    "std Z+AVR_CONTEXT_OFFSET_R2+10, r12\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R2+11, r13\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R2+12, r14\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R2+13, r15\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R2+14, r16\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R2+15, r17\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R28+0, r28\n"                             \
+    "std Z+AVR_CONTEXT_OFFSET_R28+1, r29\n"                             \
+    /* Switch from Z to Y, then pop and save the rest. */               \
+    "mov r28, r30\n"                                                    \
+    "mov r29, r31\n"                                                    \
+    "pop r31\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R30+1, r31\n"                             \
+    "pop r30\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R30+0, r30\n"                             \
+    "pop r27\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+9, r27\n"                             \
+    "pop r26\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+8, r26\n"                             \
+    "pop r25\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+7, r25\n"                             \
+    "pop r24\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+6, r24\n"                             \
+    "pop r23\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+5, r23\n"                             \
+    "pop r22\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+4, r22\n"                             \
+    "pop r21\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+3, r21\n"                             \
+    "pop r20\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+2, r20\n"                             \
+    "pop r19\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+1, r19\n"                             \
+    "pop r18\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R18+0, r18\n"                             \
+    AVR_CONTEXT_IF_SAVE_RAMPZ(                                          \
+        "pop r18\n"                                                     \
+        "std Y+AVR_CONTEXT_OFFSET_RAMPZ, r18\n")                        \
+    "pop r18\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R1, r18\n"                                \
+    "pop r18\n" /* SREG */                                              \
+    "\n" sreg_code "\n"                                                 \
+    "std Y+AVR_CONTEXT_OFFSET_SREG, r18\n"                              \
+    "pop r18\n"                                                         \
+    "std Y+AVR_CONTEXT_OFFSET_R0, r18\n"                                \
+    /* Pop and save the return address. */                              \
+    AVR_CONTEXT_IF_3_BYTE_PC(                                           \
+        "pop r18\n" /* extended part */                                 \
+        "std Y+AVR_CONTEXT_OFFSET_PC_E, r18\n")                         \
+    "pop r19\n" /* high part */                                         \
+    "pop r18\n" /* low part */                                          \
+    "std Y+AVR_CONTEXT_OFFSET_PC_L, r18\n"                              \
+    "std Y+AVR_CONTEXT_OFFSET_PC_H, r19\n"                              \
+    /* Save the stack pointer. */                                       \
+    "in r18, __SP_L__\n"                                                \
+    "in r19, __SP_H__\n"                                                \
+    "std Y+AVR_CONTEXT_OFFSET_SP_L, r18\n"                              \
+    "std Y+AVR_CONTEXT_OFFSET_SP_H, r19\n"                              \
+    AVR_CONTEXT_STORE_EIND("Y", "0", "r18")
+
+#define AVR_SAVE_CONTEXT_PARTIAL()                                      \
+    __asm__ __volatile__(AVR_CONTEXT_ISR_SAVE_PARTIAL)
+
+#define AVR_RESTORE_CONTEXT_PARTIAL()                                   \
+    __asm__ __volatile__(AVR_CONTEXT_ISR_RESTORE_PARTIAL)
+
+#define AVR_SAVE_CONTEXT_REST(sreg_code, load_address_to_Z_code)        \
+    __asm__ __volatile__(                                               \
+        AVR_CONTEXT_ISR_SAVE_REST(sreg_code, load_address_to_Z_code))
+
+#define AVR_SAVE_CONTEXT_REST_GLOBAL_POINTER(sreg_code, global_context_pointer) \
+    AVR_SAVE_CONTEXT_REST(                                              \
+        sreg_code,                                                      \
+        "lds ZL, "#global_context_pointer"\n"                           \
+        "lds ZH, "#global_context_pointer" + 1\n")
+
+/*
+AVR_ISR_SWITCH_GLOBAL_POINTER macro expands to the body of a naked
+interrupt routine built on top of the macros above. It calls the
+function 'handler', which should be an ordinary C function of type
+uint8_t (*)(void), with the registers saved by
+AVR_SAVE_CONTEXT_PARTIAL. If the function returns zero, the routine
+returns right away. Otherwise, it saves the rest of the context into
+the structure pointed at by the global pointer variable
+'global_context_pointer' (see AVR_SAVE_CONTEXT_GLOBAL_POINTER),
+executes the code passed as 'code' argument, which may change the
+pointer, and restores the context it points at.
+
+The argument 'sreg_code' is the same as for AVR_SAVE_CONTEXT_REST.
+
+Example:
+
+static uint8_t motor_isr(void)
+{
+    ...
+    return ++ticks == 10; // request a switch on every tenth tick
+}
+
+ISR(TIMER1_COMPA_vect, ISR_NAKED)
+{
+    AVR_ISR_SWITCH_GLOBAL_POINTER(motor_isr, "", switch_task(), current_task_ctx);
+}
+
+When no switch is requested, it takes about as long as an interrupt
+routine written in C which calls 'handler'.
+*/
+#define AVR_ISR_SWITCH_GLOBAL_POINTER(handler, sreg_code, code, global_context_pointer) \
+    do {                                                                \
+        __asm__ __volatile__(                                           \
+            AVR_CONTEXT_ISR_SAVE_PARTIAL                                \
+            "%~call %x0\n"                                              \
+            "tst r24\n"                                                 \
+            "brne 1f\n"                                                 \
+            AVR_CONTEXT_ISR_RESTORE_PARTIAL                             \
+            "reti\n"                                                    \
+            "1:\n"                                                      \
+            AVR_CONTEXT_ISR_SAVE_REST(                                  \
+                sreg_code,                                              \
+                "lds ZL, "#global_context_pointer"\n"                   \
+                "lds ZH, "#global_context_pointer" + 1\n")              \
+            "clr r1\n"                                                  \
+            :: "i" (handler));                                          \
+        code;                                                           \
+        AVR_RESTORE_CONTEXT_GLOBAL_POINTER(global_context_pointer);     \
+        __asm__ __volatile__("reti\n");                                 \
+    } while (0)
+
 #endif /* __AVR__ */
 
 #endif /* AVRCONTEXT_H */
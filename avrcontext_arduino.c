@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
 
 #include "avrcontext.h"
 #include "avrcontext_impl.h"
@@ -16,5 +17,32 @@
 #include "avrcoro.h"
 #include "avrcoro_impl.h"
 
+#include "avrchan.h"
+#include "avrchan_impl.h"
+
+#include "avrpipe.h"
+#include "avrpipe_impl.h"
+
+#include "avrevent.h"
+#include "avrevent_impl.h"
+
+#include "avrsleep.h"
+#include "avrsleep_impl.h"
+
+#include "avrshared.h"
+#include "avrshared_impl.h"
+
+#include "avrrunq.h"
+#include "avrrunq_impl.h"
+
+#include "avrio.h"
+#include "avrio_impl.h"
+
+#include "avrprof.h"
+#include "avrprof_impl.h"
+
+#include "avrsched.h"
+#include "avrsched_impl.h"
+
 #endif
 
@@ -15,6 +15,16 @@
 #include <avr/io.h>
 #include "avrcontext.h"
 #include "avrcoro.h"
+#include "avrcoro_cxx.h"
+#include "avrchan.h"
+#include "avrpipe.h"
+#include "avrevent.h"
+#include "avrsleep.h"
+#include "avrshared.h"
+#include "avrrunq.h"
+#include "avrio.h"
+#include "avrprof.h"
+#include "avrsched.h"
 
 #endif /* AVRCONTEXT_ARDUINO_H */
 
@@ -53,37 +53,528 @@ void avr_swapcontext(avr_context_t *oucp, const avr_context_t *ucp)
     __asm__ __volatile__ ("ret\n");
 }
 
+/*
+AVR_CONTEXT_COOP_SAVE and AVR_CONTEXT_COOP_RESTORE expand to the
+assembly code shared by the cooperative context switching functions.
+The argument 'offset' is the prefix of the assembler constants which
+define the layout of the context structure pointed to by Z.
+
+The save code expects the return address on top of the stack and
+leaves it popped (it remains in R21:R20, the extended part of a 3-byte
+return address remains in R0). The restore code leaves the return
+address of the restored context on top of the stack. Both of them
+clobber R0, R18-R21.
+*/
+#define AVR_CONTEXT_COOP_SAVE(offset)                                   \
+    /* Save call-saved registers. */                                    \
+    "std Z+" #offset "_R2+0, r2\n"                                      \
+    "std Z+" #offset "_R2+1, r3\n"                                      \
+    "std Z+" #offset "_R2+2, r4\n"                                      \
+    "std Z+" #offset "_R2+3, r5\n"                                      \
+    "std Z+" #offset "_R2+4, r6\n"                                      \
+    "std Z+" #offset "_R2+5, r7\n"                                      \
+    "std Z+" #offset "_R2+6, r8\n"                                      \
+    "std Z+" #offset "_R2+7, r9\n"                                      \
+    "std Z+" #offset "_R2+8, r10\n"                                     \
+    "std Z+" #offset "_R2+9, r11\n"                                     \
+    "std Z+" #offset "_R2+10, r12\n"                                    \
+    "std Z+" #offset "_R2+11, r13\n"                                    \
+    "std Z+" #offset "_R2+12, r14\n"                                    \
+    "std Z+" #offset "_R2+13, r15\n"                                    \
+    "std Z+" #offset "_R2+14, r16\n"                                    \
+    "std Z+" #offset "_R2+15, r17\n"                                    \
+    "std Z+" #offset "_R28+0, r28\n"                                    \
+    "std Z+" #offset "_R28+1, r29\n"                                    \
+    /* Pop and save the return address. */                              \
+    AVR_CONTEXT_IF_3_BYTE_PC(                                           \
+        "pop r0\n" /* extended part */                                  \
+        "std Z+" #offset "_PC_E, r0\n")                                 \
+    "pop r21\n" /* high part */                                         \
+    "pop r20\n" /* low part */                                          \
+    "std Z+" #offset "_PC_L, r20\n"                                     \
+    "std Z+" #offset "_PC_H, r21\n"                                     \
+    /* Save the stack pointer. */                                       \
+    "in r18, __SP_L__\n"                                                \
+    "in r19, __SP_H__\n"                                                \
+    "std Z+" #offset "_SP_L, r18\n"                                     \
+    "std Z+" #offset "_SP_H, r19\n"
+
+#define AVR_CONTEXT_COOP_RESTORE(offset)                                \
+    /* Restore call-saved registers. */                                 \
+    "ldd r2, Z+" #offset "_R2+0\n"                                      \
+    "ldd r3, Z+" #offset "_R2+1\n"                                      \
+    "ldd r4, Z+" #offset "_R2+2\n"                                      \
+    "ldd r5, Z+" #offset "_R2+3\n"                                      \
+    "ldd r6, Z+" #offset "_R2+4\n"                                      \
+    "ldd r7, Z+" #offset "_R2+5\n"                                      \
+    "ldd r8, Z+" #offset "_R2+6\n"                                      \
+    "ldd r9, Z+" #offset "_R2+7\n"                                      \
+    "ldd r10, Z+" #offset "_R2+8\n"                                     \
+    "ldd r11, Z+" #offset "_R2+9\n"                                     \
+    "ldd r12, Z+" #offset "_R2+10\n"                                    \
+    "ldd r13, Z+" #offset "_R2+11\n"                                    \
+    "ldd r14, Z+" #offset "_R2+12\n"                                    \
+    "ldd r15, Z+" #offset "_R2+13\n"                                    \
+    "ldd r16, Z+" #offset "_R2+14\n"                                    \
+    "ldd r17, Z+" #offset "_R2+15\n"                                    \
+    "ldd r28, Z+" #offset "_R28+0\n"                                    \
+    "ldd r29, Z+" #offset "_R28+1\n"                                    \
+    "ldd r18, Z+" #offset "_SP_L\n"                                     \
+    "ldd r19, Z+" #offset "_SP_H\n"                                     \
+    "ldd r20, Z+" #offset "_PC_L\n"                                     \
+    "ldd r21, Z+" #offset "_PC_H\n"                                     \
+    /* Restore the stack pointer atomically. */                         \
+    AVR_CONTEXT_OUT_SP_ATOMIC("r18", "r19", "r0")                       \
+    /* Put the return address on the top of the stack. */               \
+    "push r20\n" /* low part */                                         \
+    "push r21\n" /* high part */                                        \
+    AVR_CONTEXT_IF_3_BYTE_PC(                                           \
+        "ldd r0, Z+" #offset "_PC_E\n"                                  \
+        "push r0\n") /* extended part */
+
+void avr_swapcontext_coop(avr_context_t *oucp, const avr_context_t *ucp)  __attribute__ ((naked));
+void avr_swapcontext_coop(avr_context_t *oucp, const avr_context_t *ucp)
+{
+    (void)oucp; /* to avoid compiler warnings */
+    (void)ucp;
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        /* Save SREG and R1 (always zero at this point), so that the */
+        /* context could be activated by avr_setcontext() as well. */
+        "in r0, __SREG__\n"
+        "std Z+AVR_CONTEXT_OFFSET_SREG, r0\n"
+        "std Z+AVR_CONTEXT_OFFSET_R1, r1\n"
+        AVR_CONTEXT_STORE_EXTRA("Z", "0", "r0")
+        AVR_CONTEXT_COOP_SAVE(AVR_CONTEXT_OFFSET)
+        /* Switch to the other context. */
+        "mov r30, r22\n"
+        "mov r31, r23\n"
+        AVR_CONTEXT_COOP_RESTORE(AVR_CONTEXT_OFFSET)
+        "ret\n");
+}
+
+void avr_coop_getcontext(avr_coop_context_t *cp) __attribute__ ((naked));
+void avr_coop_getcontext(avr_coop_context_t *cp)
+{
+    (void)cp; /* to avoid compiler warnings */
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        AVR_CONTEXT_COOP_SAVE(AVR_COOP_CONTEXT_OFFSET)
+        /* Push the return address back at the top of the stack. */
+        "push r20\n" /* low part */
+        "push r21\n" /* high part */
+        AVR_CONTEXT_IF_3_BYTE_PC("push r0\n") /* extended part */
+        "ret\n");
+}
+
+void avr_coop_setcontext(const avr_coop_context_t *cp) __attribute__ ((naked));
+void avr_coop_setcontext(const avr_coop_context_t *cp)
+{
+    (void)cp; /* to avoid compiler warnings */
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        AVR_CONTEXT_COOP_RESTORE(AVR_COOP_CONTEXT_OFFSET)
+        "ret\n");
+}
+
+void avr_coop_swapcontext(avr_coop_context_t *oucp, const avr_coop_context_t *ucp) __attribute__ ((naked));
+void avr_coop_swapcontext(avr_coop_context_t *oucp, const avr_coop_context_t *ucp)
+{
+    (void)oucp; /* to avoid compiler warnings */
+    (void)ucp;
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        AVR_CONTEXT_COOP_SAVE(AVR_COOP_CONTEXT_OFFSET)
+        "mov r30, r22\n"
+        "mov r31, r23\n"
+        AVR_CONTEXT_COOP_RESTORE(AVR_COOP_CONTEXT_OFFSET)
+        "ret\n");
+}
+
+/*
+The data passing variants keep the value in R24:R25 (the return value
+register pair): neither AVR_CONTEXT_COOP_SAVE nor
+AVR_CONTEXT_COOP_RESTORE touches these registers.
+*/
+void *avr_coop_swapcontext_data(avr_coop_context_t *oucp, const avr_coop_context_t *ucp, void *data) __attribute__ ((naked));
+void *avr_coop_swapcontext_data(avr_coop_context_t *oucp, const avr_coop_context_t *ucp, void *data)
+{
+    (void)oucp; /* to avoid compiler warnings */
+    (void)ucp;
+    (void)data;
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        "mov r24, r20\n"
+        "mov r25, r21\n"
+        AVR_CONTEXT_COOP_SAVE(AVR_COOP_CONTEXT_OFFSET)
+        "mov r30, r22\n"
+        "mov r31, r23\n"
+        AVR_CONTEXT_COOP_RESTORE(AVR_COOP_CONTEXT_OFFSET)
+        "ret\n");
+}
+
+void avr_coop_setcontext_data(const avr_coop_context_t *cp, void *data) __attribute__ ((naked));
+void avr_coop_setcontext_data(const avr_coop_context_t *cp, void *data)
+{
+    (void)cp; /* to avoid compiler warnings */
+    (void)data;
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        "mov r24, r22\n"
+        "mov r25, r23\n"
+        AVR_CONTEXT_COOP_RESTORE(AVR_COOP_CONTEXT_OFFSET)
+        "ret\n");
+}
+
+avr_try_t *avr_try_top;
+
+int avr_try(avr_try_t *frame) __attribute__ ((naked));
+int avr_try(avr_try_t *frame)
+{
+    (void)frame; /* to avoid compiler warnings */
+    __asm__ __volatile__(
+        "mov r30, r24\n"
+        "mov r31, r25\n"
+        AVR_CONTEXT_COOP_SAVE(AVR_COOP_CONTEXT_OFFSET)
+        /* Push the return address back at the top of the stack. */
+        "push r20\n" /* low part */
+        "push r21\n" /* high part */
+        AVR_CONTEXT_IF_3_BYTE_PC("push r0\n") /* extended part */
+        /* Put the frame on top of the chain. */
+        "lds r18, avr_try_top\n"
+        "lds r19, avr_try_top + 1\n"
+        "std Z+AVR_TRY_OFFSET_PREV, r18\n"
+        "std Z+AVR_TRY_OFFSET_PREV+1, r19\n"
+        "sts avr_try_top, r30\n"
+        "sts avr_try_top + 1, r31\n"
+        /* Return 0. */
+        "clr r24\n"
+        "clr r25\n"
+        "ret\n");
+}
+
+void avr_throw(int code)
+{
+    avr_try_t *frame = avr_try_top;
+    if (frame != NULL)
+    {
+        avr_try_top = frame->prev;
+        /* The value travels in R24:R25, so that it gets returned by
+         * the avr_try() call which has saved the context. */
+        avr_coop_setcontext_data(&frame->ctx, (void *)(uintptr_t)(code != 0 ? code : 1));
+    }
+    /* halt */
+    for (;;)
+    {
+        __asm__ __volatile__("cli\n" ::: "memory");
+    }
+}
+
+/*
+The entry point of every context initialised by avr_makecontext() or
+avr_coop_makecontext().
+
+The arguments are passed in the call-saved registers, so that both the
+full and the cooperative restore paths could activate the context:
+successor: registers 2, 3; func: registers 4, 5; funcarg: 6, 7; the
+function which activates the successor: registers 8, 9.
+*/
 #ifdef __cplusplus
 extern "C" {
 #endif /*__cplusplus **/
-static void avr_makecontext_callfunc(const avr_context_t *successor, void (*func)(void *), void *funcarg);
+static void avr_makecontext_entry(void) __attribute__ ((naked, used));
 #ifdef __cplusplus
 }
 #endif /*__cplusplus */
-static void avr_makecontext_callfunc(const avr_context_t *successor, void (*func)(void *), void *funcarg)
+static void avr_makecontext_entry(void)
 {
-    func(funcarg);
-    avr_setcontext(successor);
+    __asm__ __volatile__(
+        /* func(funcarg) */
+        "mov r24, r6\n"
+        "mov r25, r7\n"
+        "mov r30, r4\n"
+        "mov r31, r5\n"
+        "icall\n"
+        /* activate(successor), R2, R3, R8, R9 survive the call. */
+        "mov r24, r2\n"
+        "mov r25, r3\n"
+        "mov r30, r8\n"
+        "mov r31, r9\n"
+        "ijmp\n");
 }
 
-void avr_makecontext(avr_context_t *cp, void *stackp, const size_t stack_size, const avr_context_t *successor_cp, void (*funcp)(void *), void *funcargp)
+/* Initialise registers R2-R9 ('regs') to pass arguments to avr_makecontext_entry. */
+static void avr_makecontext_setregs(uint8_t *regs,
+                                    const void *successor_cp, uint16_t activatep,
+                                    uint16_t funcp, const void *funcargp)
 {
     uint16_t addr;
     uint8_t *p = (uint8_t *)&addr;
-    /* initialise stack pointer and program counter */
-    cp->sp.ptr = ((uint8_t *)stackp + stack_size - 1);
-    cp->pc.ptr = (void *)avr_makecontext_callfunc;
-    /* initialise registers to pass arguments to avr_makecontext_callfunc */
-    /* successor: registers 24,25; func registers 23, 22; funcarg: 21, 20. */
     addr = (uint16_t)successor_cp;
-    cp->r[24] = p[0];
-    cp->r[25] = p[1];
-    addr = (uint16_t)funcp;
-    cp->r[22] = p[0];
-    cp->r[23] = p[1];
+    regs[0] = p[0];
+    regs[1] = p[1];
+    addr = funcp;
+    regs[2] = p[0];
+    regs[3] = p[1];
     addr = (uint16_t)funcargp;
-    cp->r[20] = p[0];
-    cp->r[21] = p[1];
+    regs[4] = p[0];
+    regs[5] = p[1];
+    addr = activatep;
+    regs[6] = p[0];
+    regs[7] = p[1];
+}
+
+void avr_stack_paint(void *stackp, const size_t stack_size)
+{
+    uint8_t *p = (uint8_t *)stackp;
+    size_t i;
+    for (i = 0; i < stack_size; i++)
+    {
+        p[i] = AVR_CONTEXT_STACK_PATTERN;
+    }
+}
+
+size_t avr_stack_used(const void *stackp, const size_t stack_size)
+{
+    const uint8_t *p = (const uint8_t *)stackp;
+#if AVR_CONTEXT_STACK_CANARY
+    size_t i = sizeof(uint16_t); /* skip the guard word */
+#else
+    size_t i = 0;
+#endif /* AVR_CONTEXT_STACK_CANARY */
+    while (i < stack_size && p[i] == AVR_CONTEXT_STACK_PATTERN)
+    {
+        i++;
+    }
+    return i >= stack_size ? 0 : stack_size - i;
+}
+
+static avr_stack_overflow_handler_t avr_stack_overflow_handler;
+
+void avr_stack_guard(void *stackp)
+{
+    *(uint16_t *)stackp = (uint16_t)AVR_CONTEXT_STACK_CANARY_VALUE;
+}
+
+int avr_stack_check(const void *stackp)
+{
+    return *(const uint16_t *)stackp != (uint16_t)AVR_CONTEXT_STACK_CANARY_VALUE;
+}
+
+void avr_stack_overflow(const void *stackp)
+{
+    if (avr_stack_overflow_handler != NULL)
+    {
+        avr_stack_overflow_handler(stackp);
+        return;
+    }
+    /* halt */
+    for (;;)
+    {
+        __asm__ __volatile__("cli\n" ::: "memory");
+    }
+}
+
+void avr_stack_set_overflow_handler(avr_stack_overflow_handler_t handler)
+{
+    avr_stack_overflow_handler = handler;
+}
+
+int avr_stack_pool_init(avr_stack_pool_t *pool,
+                        void *arenap, const size_t arena_size,
+                        const size_t block_size)
+{
+    uint8_t *block = (uint8_t *)arenap;
+    size_t left = arena_size;
+    if (pool == NULL || arenap == NULL || block_size < sizeof(void *))
+    {
+        return 1;
+    }
+    pool->free = NULL;
+    pool->block_size = block_size;
+    while (left >= block_size)
+    {
+        avr_stack_pool_release(pool, block);
+        block += block_size;
+        left -= block_size;
+    }
+    return 0;
+}
+
+void *avr_stack_pool_acquire(avr_stack_pool_t *pool)
+{
+    void *block;
+    if (pool == NULL || pool->free == NULL)
+    {
+        return NULL;
+    }
+    block = pool->free;
+    pool->free = *(void **)block;
+    return block;
+}
+
+int avr_stack_pool_release(avr_stack_pool_t *pool, void *stackp)
+{
+    if (pool == NULL || stackp == NULL)
+    {
+        return 1;
+    }
+    *(void **)stackp = pool->free;
+    pool->free = stackp;
+    return 0;
+}
+
+#if AVR_CONTEXT_STATS
+void avr_stats_switch(avr_stats_t *from, avr_stats_t *to)
+{
+    const uint16_t now = AVR_CONTEXT_STATS_CLOCK();
+    if (from != NULL)
+    {
+        from->cycles += (uint16_t)(now - from->since);
+    }
+    if (to != NULL)
+    {
+        to->since = now;
+        to->switches++;
+    }
+}
+
+int avr_stats_read(const avr_stats_t *stats, avr_stats_t *snapshot)
+{
+    uint8_t sreg;
+    if (stats == NULL || snapshot == NULL)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    *snapshot = *stats;
+    __asm__ __volatile__("" ::: "memory");
+    SREG = sreg;
+    return 0;
+}
+
+int avr_stats_reset(avr_stats_t *stats)
+{
+    uint8_t sreg;
+    if (stats == NULL)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    stats->cycles = 0;
+    stats->switches = 0;
+    __asm__ __volatile__("" ::: "memory");
+    SREG = sreg;
+    return 0;
+}
+#endif /* AVR_CONTEXT_STATS */
+
+void avr_makecontext(avr_context_t *cp, void *stackp, const size_t stack_size, const avr_context_t *successor_cp, void (*funcp)(void *), void *funcargp)
+{
+#if AVR_CONTEXT_STACK_PAINT
+    avr_stack_paint(stackp, stack_size);
+#endif /* AVR_CONTEXT_STACK_PAINT */
+#if AVR_CONTEXT_STACK_CANARY
+    avr_stack_guard(stackp);
+#endif /* AVR_CONTEXT_STACK_CANARY */
+    /* initialise stack pointer and program counter */
+    cp->sp.ptr = ((uint8_t *)stackp + stack_size - 1);
+    cp->pc.ptr = (void *)avr_makecontext_entry;
+#if AVR_CONTEXT_3_BYTE_PC
+    /* The function pointers refer to the lowest 128 KB (the compiler
+     * generates stubs for the functions above). */
+    cp->pc_ext = 0;
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+    /* initialise registers to pass arguments to avr_makecontext_entry */
+    avr_makecontext_setregs(&cp->r[2],
+                            successor_cp, (uint16_t)avr_setcontext,
+                            (uint16_t)funcp, funcargp);
+}
+
+void avr_initcontext(avr_context_t *cp, void *stackp, const size_t stack_size, const avr_context_t *successor_cp, void (*funcp)(void *), void *funcargp, uint8_t interrupts)
+{
+    uint8_t i;
+    cp->sreg = interrupts ? 0x80 : 0;
+    for (i = 0; i < 32; i++)
+    {
+        cp->r[i] = 0;
+    }
+#if AVR_CONTEXT_SAVE_RAMPZ
+    cp->rampz = 0;
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+#if AVR_CONTEXT_SAVE_EIND
+    cp->eind = 0;
+#endif /* AVR_CONTEXT_SAVE_EIND */
+    avr_makecontext(cp, stackp, stack_size, successor_cp, funcp, funcargp);
+}
+
+void avr_coop_makecontext(avr_coop_context_t *cp, void *stackp, const size_t stack_size, const avr_coop_context_t *successor_cp, void (*funcp)(void *), void *funcargp)
+{
+#if AVR_CONTEXT_STACK_PAINT
+    avr_stack_paint(stackp, stack_size);
+#endif /* AVR_CONTEXT_STACK_PAINT */
+#if AVR_CONTEXT_STACK_CANARY
+    avr_stack_guard(stackp);
+#endif /* AVR_CONTEXT_STACK_CANARY */
+    /* initialise stack pointer and program counter */
+    cp->sp.ptr = ((uint8_t *)stackp + stack_size - 1);
+    cp->pc.ptr = (void *)avr_makecontext_entry;
+#if AVR_CONTEXT_3_BYTE_PC
+    cp->pc_ext = 0;
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+    /* initialise registers to pass arguments to avr_makecontext_entry */
+    /* (the first element of 'r' holds the value of R2) */
+    avr_makecontext_setregs(&cp->r[0],
+                            successor_cp, (uint16_t)avr_coop_setcontext,
+                            (uint16_t)funcp, funcargp);
+}
+
+void avr_stack_makecontext(avr_stack_context_t *cp, void *stackp, const size_t stack_size, const avr_context_t *successor_cp, void (*funcp)(void *), void *funcargp)
+{
+    uint8_t regs[8];
+    uint8_t *sp = (uint8_t *)stackp + stack_size - 1;
+    uint16_t addr = (uint16_t)avr_makecontext_entry;
+    uint8_t *p = (uint8_t *)&addr;
+    size_t i;
+#if AVR_CONTEXT_STACK_PAINT
+    avr_stack_paint(stackp, stack_size);
+#endif /* AVR_CONTEXT_STACK_PAINT */
+#if AVR_CONTEXT_STACK_CANARY
+    avr_stack_guard(stackp);
+#endif /* AVR_CONTEXT_STACK_CANARY */
+    avr_makecontext_setregs(&regs[0],
+                            successor_cp, (uint16_t)avr_setcontext,
+                            (uint16_t)funcp, funcargp);
+    /* push the return address (PC) as the CALL instruction does */
+    *sp-- = p[0]; /* low part */
+    *sp-- = p[1]; /* high part */
+#if AVR_CONTEXT_3_BYTE_PC
+    *sp-- = 0; /* extended part, see avr_makecontext() */
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+    /* push the registers in the order AVR_SAVE_CONTEXT_STACK does */
+    *sp-- = 0; /* R0 */
+    *sp-- = 0; /* SREG */
+    *sp-- = 0; /* R1 */
+    for (i = 2; i < 32; i++)
+    {
+        *sp-- = i < 10 ? regs[i - 2] : 0;
+    }
+    /* in the order AVR_CONTEXT_PUSH_EXTRA does */
+#if AVR_CONTEXT_SAVE_RAMPZ
+    *sp-- = 0; /* RAMPZ */
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+#if AVR_CONTEXT_SAVE_EIND
+    *sp-- = 0; /* EIND */
+#endif /* AVR_CONTEXT_SAVE_EIND */
+    cp->sp.ptr = sp;
 }
 
 #if __cplusplus >= 201103L
@@ -94,12 +585,44 @@ inline void avr_context_sanity_checks(void)
 {
     avr_context_t test;
     static_assert(reinterpret_cast<uintptr_t>(&test) == reinterpret_cast<uintptr_t>(&test.sreg));
-    static_assert(sizeof(avr_context_t) == 37);
+    static_assert(sizeof(avr_context_t) == 37 + (AVR_CONTEXT_3_BYTE_PC != 0) + (AVR_CONTEXT_SAVE_RAMPZ != 0) + (AVR_CONTEXT_SAVE_EIND != 0));
     static_assert(reinterpret_cast<uintptr_t>(&test.sp.part.low) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_SP_L);
     static_assert(reinterpret_cast<uintptr_t>(&test.sp.part.high) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_SP_H);
     static_assert(reinterpret_cast<uintptr_t>(&test.pc.part.low) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_PC_L);
     static_assert(reinterpret_cast<uintptr_t>(&test.pc.part.high) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_PC_H);
     static_assert(reinterpret_cast<uintptr_t>(&test.sp.part.high) - reinterpret_cast<uintptr_t>(&test.r[26]) == AVR_CONTEXT_BACK_OFFSET_R26);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[0]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R0);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[1]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R1);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[2]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R2);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[18]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R18);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[28]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R28);
+    static_assert(reinterpret_cast<uintptr_t>(&test.r[30]) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_R30);
+
+    static_assert(sizeof(avr_stack_context_t) == 2);
+#if AVR_CONTEXT_3_BYTE_PC
+    static_assert(reinterpret_cast<uintptr_t>(&test.pc_ext) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_PC_E);
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+#if AVR_CONTEXT_SAVE_RAMPZ
+    static_assert(reinterpret_cast<uintptr_t>(&test.rampz) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_RAMPZ);
+#endif /* AVR_CONTEXT_SAVE_RAMPZ */
+#if AVR_CONTEXT_SAVE_EIND
+    static_assert(reinterpret_cast<uintptr_t>(&test.eind) - reinterpret_cast<uintptr_t>(&test) == AVR_CONTEXT_OFFSET_EIND);
+#endif /* AVR_CONTEXT_SAVE_EIND */
+
+    avr_coop_context_t coop_test;
+    static_assert(sizeof(avr_coop_context_t) == 22 + (AVR_CONTEXT_3_BYTE_PC != 0));
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.r[0]) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_R2);
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.r[16]) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_R28);
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.pc.part.low) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_PC_L);
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.pc.part.high) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_PC_H);
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.sp.part.low) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_SP_L);
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.sp.part.high) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_SP_H);
+#if AVR_CONTEXT_3_BYTE_PC
+    static_assert(reinterpret_cast<uintptr_t>(&coop_test.pc_ext) - reinterpret_cast<uintptr_t>(&coop_test) == AVR_COOP_CONTEXT_OFFSET_PC_E);
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+    avr_try_t try_test;
+    static_assert(reinterpret_cast<uintptr_t>(&try_test.prev) - reinterpret_cast<uintptr_t>(&try_test) == AVR_TRY_OFFSET_PREV);
 }
 #endif /* __cplusplus */
 
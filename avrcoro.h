@@ -18,13 +18,27 @@ typedef enum avr_coro_state_t_ {
     AVR_CORO_ILLEGAL,
 } avr_coro_state_t;
 
-/* Coroutine definition */
+/* Coroutine definition. Coroutines switch only cooperatively, so the
+ * compact contexts are enough to keep their state. */
 typedef struct avr_coro_t_ {
     char status;
-    avr_context_t ret;
-    avr_context_t exec;
-    void *data;
+    avr_coop_context_t ret;
+    avr_coop_context_t exec;
+    void *data; /* the argument of the first resumption */
     void *funcp;
+    struct avr_coro_t_ *next; /* the run queue link (see avrrunq.h) */
+#if AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY
+    void *stackp;
+    size_t stack_size;
+#endif /* AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_STATS
+    avr_stats_t stats;
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_TRY
+    /* the chain of protected regions of the coroutine while it is
+     * suspended, or of its invoker while it is running */
+    avr_try_t *try_chain;
+#endif /* AVR_CONTEXT_TRY */
 } avr_coro_t;
 
 /* Coroutine function type */
@@ -36,7 +50,8 @@ extern "C" {
 /*
 There are four functions that implement the asymmetric stackful
 coroutine facility: avr_coro_init(), avr_coro_resume(),
-avr_coro_yield(), avr_coro_state().
+avr_coro_yield(), avr_coro_state(). The rest of the functions below
+extend it.
 
 A coroutine is represented by the "avr_coro_t"
 opaque data type. A coroutine can be in one of the following states.
@@ -103,6 +118,50 @@ context of the currently running coroutine.
 The value "AVR_CORO_ILLEGAL" gets returned in the case of error
 (e.g. the "NULL" value was passed instead of a pointer to a
 coroutine).
+
+The function avr_coro_transfer() passes control from the currently
+running coroutine "self" directly to the suspended coroutine "target"
+(symmetric transfer). It costs a single context switch, while doing
+the same by yielding to a dispatcher which resumes the "target" costs
+two. The "data" argument is treated the same way as by
+avr_coro_yield(): the "target" receives the value "data" points to,
+and when "self" gets activated again, the pointer gets initialised to
+the value passed by the activating side. The "self" coroutine becomes
+suspended, and the "target" one takes over the invoker of "self": when
+it yields (or dies), control returns to the avr_coro_resume() call
+which has activated "self", and the value gets delivered there as if
+"self" had yielded it.
+
+The function avr_coro_reset() re-initialises a dead coroutine pointed
+at by "coro" in the suspended state, so that upon resumption the
+function "func" gets called on the same stack as before. It is
+cheaper than avr_coro_init(): only the fields the coroutine start-up
+code needs get written. It fails if the coroutine is not dead, or if
+its stack has been released to a pool (see avr_coro_init_pooled()).
+
+The function avr_coro_init_pooled() initialises a coroutine in the
+same way as avr_coro_init() does, but the stack gets acquired from
+the stack pool pointed at by "pool" (see avr_stack_pool_init()). The
+stack gets released back to the pool automatically when the coroutine
+becomes dead. A few bytes at the top of the block are used for the
+bookkeeping. The function fails if the pool is exhausted.
+
+The function avr_coro_stack_used() is available only when the stack
+painting is enabled (see AVR_CONTEXT_STACK_PAINT in avrcontext.h). It
+returns the peak number of bytes of the coroutine stack used so far
+(see avr_stack_used()), or 0 if the "NULL" value was passed.
+
+When the stack overflow detection is enabled (see
+AVR_CONTEXT_STACK_CANARY in avrcontext.h), the guard word of the
+coroutine stack gets checked every time the coroutine yields, transfers
+control, or dies.
+
+The function avr_coro_stats() is available only when the accounting
+is enabled (see AVR_CONTEXT_STATS in avrcontext.h). It copies the
+statistics of the coroutine into "snapshot" (see avr_stats_read()):
+the time the coroutine has been running for since its initialisation
+(including the time spent in the interrupt routines and in the
+coroutines it has resumed), and the number of its activations.
 */
 extern int avr_coro_init(avr_coro_t *coro,
                          void *stackp, const size_t stack_size,
@@ -110,10 +169,52 @@ extern int avr_coro_init(avr_coro_t *coro,
 extern int avr_coro_resume(avr_coro_t *coro, void **data);
 extern int avr_coro_yield(avr_coro_t *self, void **data);
 extern avr_coro_state_t avr_coro_state(const avr_coro_t *coro);
+extern int avr_coro_transfer(avr_coro_t *self, avr_coro_t *target, void **data);
+extern int avr_coro_reset(avr_coro_t *coro, avr_coro_func_t func);
+extern int avr_coro_init_pooled(avr_coro_t *coro,
+                                avr_stack_pool_t *pool,
+                                avr_coro_func_t func);
+#if AVR_CONTEXT_STACK_PAINT
+extern size_t avr_coro_stack_used(const avr_coro_t *coro);
+#endif /* AVR_CONTEXT_STACK_PAINT */
+#if AVR_CONTEXT_STATS
+extern int avr_coro_stats(const avr_coro_t *coro, avr_stats_t *snapshot);
+#endif /* AVR_CONTEXT_STATS */
 #ifdef __cplusplus
 }
 #endif /*__cplusplus */
 
+/*
+The functions avr_coro_resume_unchecked() and avr_coro_yield_unchecked()
+are the hot path counterparts of avr_coro_resume() and
+avr_coro_yield(). They get inlined into the caller and perform no
+checks: the coroutine MUST be suspended (for resumption) or running
+(for yielding), which is the caller's responsibility. The data gets
+passed by value: the function returns the value passed by the other
+side. It travels in registers during the switch (see
+avr_coop_swapcontext_data()).
+
+The unchecked and the regular functions can be mixed freely on the
+same coroutine.
+*/
+static inline void *avr_coro_resume_unchecked(avr_coro_t *coro, void *data)
+{
+    coro->status = (char)AVR_CORO_RUNNING;
+    coro->data = data;
+    AVR_STATS_SWITCH(NULL, &coro->stats);
+    AVR_TRY_SWAP(coro->try_chain);
+    return avr_coop_swapcontext_data(&coro->ret, &coro->exec, data);
+}
+
+static inline void *avr_coro_yield_unchecked(avr_coro_t *self, void *data)
+{
+    self->status = (char)AVR_CORO_SUSPENDED;
+    AVR_STACK_CHECK(self->stackp);
+    AVR_STATS_SWITCH(&self->stats, NULL);
+    AVR_TRY_SWAP(self->try_chain);
+    return avr_coop_swapcontext_data(&self->exec, &self->ret, data);
+}
+
 #endif /* __AVR__ */
 #endif /* AVRCORO_H */
 
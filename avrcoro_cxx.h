@@ -0,0 +1,303 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRCORO_CXX_H
+#define AVRCORO_CXX_H
+
+#ifdef __AVR__
+#ifdef __cplusplus
+
+/*
+The minimal coroutine stack size accepted by avr::Coroutine. It covers
+the return addresses of the start-up code and of the coroutine
+function, and the frame of avr_coro_yield(). The coroutine function
+frame comes on top of that. It may be defined before including this
+file.
+*/
+#ifndef AVR_CORO_MIN_STACK_SIZE
+#define AVR_CORO_MIN_STACK_SIZE 32
+#endif /* AVR_CORO_MIN_STACK_SIZE */
+
+namespace avr {
+
+/*
+The class template avr::Coroutine is a C++11 wrapper on top of the
+coroutine facility (see avrcoro.h), which owns its stack and binds the
+coroutine function at compile time:
+
+static void *blink(avr_coro_t *self, void *data);
+static avr::Coroutine<128, blink> blinker;
+
+The stack of "StackBytes" bytes is a member of the object, so the
+coroutine could be defined at the file scope (static storage) without
+declaring the stack separately. The stack size gets checked against
+AVR_CORO_MIN_STACK_SIZE at compile time.
+
+Unlike avr_coro_init(), the coroutine function "Fn" does not get
+called through the "funcp" pointer: every instantiation gets its own
+start-up function, which calls "Fn" directly.
+
+The coroutine gets initialised in the suspended state by the
+constructor. The member functions resume() and state() correspond to
+avr_coro_resume() and avr_coro_state(). The member function reset()
+re-initialises a dead coroutine (the same way avr_coro_reset() does),
+so that it could be resumed again. The member function get() returns
+the pointer to the underlying "avr_coro_t" structure, which could be
+passed to the rest of the functions (e.g. avr_coro_transfer() or
+avr_chan_send()). The coroutine function receives the same pointer as
+"self". The member function stack_used() is available only when the
+stack painting is enabled (see avr_coro_stack_used()).
+
+The objects could be neither copied nor moved, as the saved context
+points into the stack of the object.
+*/
+template <size_t StackBytes, avr_coro_func_t Fn>
+class Coroutine {
+    static_assert(StackBytes >= AVR_CORO_MIN_STACK_SIZE,
+                  "the coroutine stack is smaller than AVR_CORO_MIN_STACK_SIZE");
+public:
+    Coroutine()
+    {
+        setup();
+    }
+
+    Coroutine(const Coroutine &) = delete;
+    Coroutine &operator=(const Coroutine &) = delete;
+
+    int resume(void **data = NULL)
+    {
+        return avr_coro_resume(&coro_, data);
+    }
+
+    avr_coro_state_t state(void) const
+    {
+        return avr_coro_state(&coro_);
+    }
+
+    int reset(void)
+    {
+        if (coro_.status != (char)AVR_CORO_DEAD)
+        {
+            return 1;
+        }
+        setup();
+        return 0;
+    }
+
+    avr_coro_t *get(void)
+    {
+        return &coro_;
+    }
+
+#if AVR_CONTEXT_STACK_PAINT
+    size_t stack_used(void) const
+    {
+        return avr_stack_used((void *)&stack_[0], StackBytes);
+    }
+#endif /* AVR_CONTEXT_STACK_PAINT */
+
+private:
+    /* The coroutine structure MUST remain the first member: the
+     * start-up function converts its argument back to the object. */
+    avr_coro_t coro_;
+    uint8_t stack_[StackBytes];
+
+    static void entry(void *argp)
+    {
+        avr_coro_t *coro = static_cast<avr_coro_t *>(argp);
+        void *ret = Fn(coro, coro->data);
+        AVR_STACK_CHECK(coro->stackp);
+        AVR_STATS_SWITCH(&coro->stats, NULL);
+        AVR_TRY_SWAP(coro->try_chain);
+        coro->status = (char)AVR_CORO_DEAD;
+        /* Keep the top of the stack for avr_coro_reset(). */
+        coro->exec.sp.ptr = &reinterpret_cast<Coroutine *>(coro)->stack_[StackBytes - 1];
+        avr_coop_setcontext_data(&coro->ret, ret);
+    }
+
+    void setup(void)
+    {
+        coro_.status = (char)AVR_CORO_SUSPENDED;
+        coro_.funcp = NULL;
+#if AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY
+        coro_.stackp = (void *)&stack_[0];
+        coro_.stack_size = StackBytes;
+#endif /* AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_STATS
+        coro_.stats.cycles = 0;
+        coro_.stats.switches = 0;
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_TRY
+        coro_.try_chain = NULL;
+#endif /* AVR_CONTEXT_TRY */
+        avr_coop_makecontext(&coro_.exec,
+                             (void *)&stack_[0], StackBytes,
+                             &coro_.ret,
+                             &Coroutine::entry, &coro_);
+    }
+};
+
+/*
+The class templates avr::Yield and avr::Generator implement typed
+generators on top of avr::Coroutine:
+
+static void digits(avr::Yield<uint8_t> &yield)
+{
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        yield(i);
+    }
+}
+
+static avr::Generator<uint8_t, 64, digits> gen;
+
+for (uint8_t digit : gen)
+{
+    ...
+}
+
+The values of type "T" get handed over to the invoker in place of the
+"void *" data pointer itself, not behind it, so "T" should fit into a
+pointer (2 bytes). This is checked at compile time.
+
+The generator function "Fn" receives an avr::Yield object. Calling it
+with a value suspends the generator and passes the value to the
+invoker. When "Fn" returns, the generator becomes dead.
+
+The member function next() resumes the generator and stores the
+yielded value into "value". It returns false when the generator has
+died instead of yielding. The member functions begin() and end()
+make the generator usable in range-based "for" loops: the loop resumes
+the generator until it dies. The member functions state(), reset() and
+get() are the same as the ones of avr::Coroutine.
+*/
+template <typename T>
+class Yield {
+    static_assert(sizeof(T) <= sizeof(void *),
+                  "the generator value type does not fit into a pointer");
+public:
+    explicit Yield(avr_coro_t *self)
+        : self_(self)
+    {
+    }
+
+    void operator()(T value)
+    {
+        avr_coro_yield_unchecked(self_, pack(value));
+    }
+
+    static void *pack(T value)
+    {
+        union { void *data; T value; } u;
+        u.data = NULL;
+        u.value = value;
+        return u.data;
+    }
+
+    static T unpack(void *data)
+    {
+        union { void *data; T value; } u;
+        u.data = data;
+        return u.value;
+    }
+
+private:
+    avr_coro_t *self_;
+};
+
+template <typename T, void (*Fn)(Yield<T> &)>
+void *generator_entry(avr_coro_t *self, void *)
+{
+    Yield<T> yield(self);
+    Fn(yield);
+    return NULL;
+}
+
+template <typename T, size_t StackBytes, void (*Fn)(Yield<T> &)>
+class Generator {
+public:
+    class iterator {
+    public:
+        explicit iterator(Generator *gen)
+            : gen_(gen)
+        {
+        }
+
+        T operator*(void) const
+        {
+            return gen_->value_;
+        }
+
+        iterator &operator++(void)
+        {
+            if (!gen_->next(gen_->value_))
+            {
+                gen_ = NULL;
+            }
+            return *this;
+        }
+
+        bool operator!=(const iterator &other) const
+        {
+            return gen_ != other.gen_;
+        }
+
+    private:
+        Generator *gen_;
+    };
+
+    bool next(T &value)
+    {
+        void *data;
+        if (coro_.state() != AVR_CORO_SUSPENDED)
+        {
+            return false;
+        }
+        data = avr_coro_resume_unchecked(coro_.get(), NULL);
+        if (coro_.state() != AVR_CORO_SUSPENDED)
+        {
+            return false;
+        }
+        value = Yield<T>::unpack(data);
+        return true;
+    }
+
+    iterator begin(void)
+    {
+        return ++iterator(this);
+    }
+
+    iterator end(void)
+    {
+        return iterator(NULL);
+    }
+
+    avr_coro_state_t state(void) const
+    {
+        return coro_.state();
+    }
+
+    int reset(void)
+    {
+        return coro_.reset();
+    }
+
+    avr_coro_t *get(void)
+    {
+        return coro_.get();
+    }
+
+private:
+    Coroutine<StackBytes, generator_entry<T, Fn> > coro_;
+    T value_;
+};
+
+} /* namespace avr */
+
+#endif /* __cplusplus */
+#endif /* __AVR__ */
+#endif /* AVRCORO_CXX_H */
@@ -10,20 +10,83 @@
 
 #ifdef __AVR__
 
+/* The bookkeeping data kept at the top of a pooled coroutine stack. */
+typedef struct avr_coro_pool_header_t_ {
+    avr_coro_t *coro;
+    avr_stack_pool_t *pool;
+} avr_coro_pool_header_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif /*__cplusplus */
 static void avr_coro_trampoline(avr_coro_t *coro);
+static void avr_coro_pool_trampoline(avr_coro_pool_header_t *header);
 #ifdef __cplusplus
 }
 #endif /*__cplusplus */
 
-static void avr_coro_trampoline(avr_coro_t *coro)
+static void *avr_coro_run(avr_coro_t *coro)
 {
     avr_coro_func_t funcp = (avr_coro_func_t)coro->funcp;
+    /* It is still the initial stack pointer (the top of the stack). */
+    void *top = coro->exec.sp.ptr;
     void *ret = funcp(coro, coro->data);
-    coro->data = ret;
+    AVR_STACK_CHECK(coro->stackp);
+    AVR_STATS_SWITCH(&coro->stats, NULL);
+    AVR_TRY_SWAP(coro->try_chain);
     coro->status = (char)AVR_CORO_DEAD;
+    /* Keep the top of the stack for avr_coro_reset(). */
+    coro->exec.sp.ptr = top;
+    return ret;
+}
+
+static void avr_coro_trampoline(avr_coro_t *coro)
+{
+    void *ret = avr_coro_run(coro);
+    /* Deliver the value to the avr_coro_resume() call in registers,
+     * instead of returning to the start-up code. */
+    avr_coop_setcontext_data(&coro->ret, ret);
+}
+
+static void avr_coro_pool_trampoline(avr_coro_pool_header_t *header)
+{
+    avr_stack_pool_t *pool = header->pool;
+    void *block = (uint8_t *)(header + 1) - pool->block_size;
+    avr_coro_t *coro = header->coro;
+    void *ret = avr_coro_run(coro);
+    /* The stack does not belong to the coroutine anymore. */
+    coro->exec.sp.ptr = NULL;
+    /* The pool links the block through its first bytes, while this
+     * frame resides at the top of it, so it is safe to release the
+     * block before leaving it. */
+    avr_stack_pool_release(pool, block);
+    avr_coop_setcontext_data(&coro->ret, ret);
+}
+
+static void avr_coro_setup(avr_coro_t *coro,
+                           void *stackp, const size_t stack_size,
+                           avr_coro_func_t funcp,
+                           avr_context_func_t trampolinep, void *argp)
+{
+    coro->status = (char)AVR_CORO_SUSPENDED;
+    coro->funcp = (void *)funcp;
+#if AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY
+    coro->stackp = stackp;
+    coro->stack_size = stack_size;
+#endif /* AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_STATS
+    coro->stats.cycles = 0;
+    coro->stats.switches = 0;
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_TRY
+    coro->try_chain = NULL;
+#endif /* AVR_CONTEXT_TRY */
+    /* no need for avr_coop_getcontext(): all of the fields the
+     * trampoline needs get initialised here */
+    avr_coop_makecontext(&coro->exec,
+                         stackp, stack_size,
+                         &coro->ret,
+                         trampolinep, argp);
 }
 
 int avr_coro_init(avr_coro_t *coro,
@@ -34,44 +97,124 @@ int avr_coro_init(avr_coro_t *coro,
     {
         return 1;
     }
+    avr_coro_setup(coro, stackp, stack_size, funcp,
+                   (avr_context_func_t)avr_coro_trampoline, coro);
+    return 0;
+}
+
+int avr_coro_init_pooled(avr_coro_t *coro,
+                         avr_stack_pool_t *pool,
+                         avr_coro_func_t funcp)
+{
+    uint8_t *block;
+    avr_coro_pool_header_t *header;
+    size_t stack_size;
+    if (coro == NULL || pool == NULL || funcp == NULL ||
+        pool->block_size <= sizeof(avr_coro_pool_header_t))
+    {
+        return 1;
+    }
+    block = (uint8_t *)avr_stack_pool_acquire(pool);
+    if (block == NULL)
+    {
+        return 1;
+    }
+    stack_size = pool->block_size - sizeof(avr_coro_pool_header_t);
+    header = (avr_coro_pool_header_t *)(block + stack_size);
+    header->coro = coro;
+    header->pool = pool;
+    avr_coro_setup(coro, block, stack_size, funcp,
+                   (avr_context_func_t)avr_coro_pool_trampoline, header);
+    return 0;
+}
+
+int avr_coro_transfer(avr_coro_t *self, avr_coro_t *target, void **data)
+{
+    void *value;
+    if (self == NULL || target == NULL ||
+        self->status != (char)AVR_CORO_RUNNING ||
+        target->status != (char)AVR_CORO_SUSPENDED)
+    {
+        return 1;
+    }
+    value = data == NULL ? NULL : *data;
+    self->status = (char)AVR_CORO_SUSPENDED;
+    target->status = (char)AVR_CORO_RUNNING;
+    /* the target returns to the invoker of self */
+    target->ret = self->ret;
+    target->data = value;
+    AVR_STACK_CHECK(self->stackp);
+    AVR_STATS_SWITCH(&self->stats, &target->stats);
+    /* leave the chain of the invoker to the target */
+    AVR_TRY_SWAP(self->try_chain);
+    AVR_TRY_SWAP(target->try_chain);
+    value = avr_coop_swapcontext_data(&self->exec, &target->exec, value);
+    if (data != NULL)
+    {
+        *data = value;
+    }
+    return 0;
+}
+
+int avr_coro_reset(avr_coro_t *coro, avr_coro_func_t funcp)
+{
+    uint8_t *top;
+    if (coro == NULL || funcp == NULL ||
+        coro->status != (char)AVR_CORO_DEAD || coro->exec.sp.ptr == NULL)
+    {
+        return 1;
+    }
+    top = (uint8_t *)coro->exec.sp.ptr;
     coro->status = (char)AVR_CORO_SUSPENDED;
     coro->funcp = (void *)funcp;
-    avr_getcontext(&coro->exec);
-    avr_makecontext(&coro->exec,
-                    stackp, stack_size,
-                    &coro->ret,
-                    (void(*)(void *))avr_coro_trampoline, coro);
+#if AVR_CONTEXT_TRY
+    coro->try_chain = NULL;
+#endif /* AVR_CONTEXT_TRY */
+#if AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY
+    /* the stack gets painted (or guarded) again */
+    (void)top;
+    avr_coop_makecontext(&coro->exec,
+                         coro->stackp, coro->stack_size,
+                         &coro->ret,
+                         (avr_context_func_t)avr_coro_trampoline, coro);
+#else
+    /* The one byte long stack at the top of the old one: only the
+     * stack pointer, the program counter and the argument registers
+     * get written. */
+    avr_coop_makecontext(&coro->exec,
+                         top, 1,
+                         &coro->ret,
+                         (avr_context_func_t)avr_coro_trampoline, coro);
+#endif /* AVR_CONTEXT_STACK_PAINT || AVR_CONTEXT_STACK_CANARY */
     return 0;
 }
 
 int avr_coro_resume(avr_coro_t *coro, void **data)
 {
+    void *value;
     if (coro == NULL || coro->status != (char)AVR_CORO_SUSPENDED)
     {
         return 1;
     }
-    coro->status = (char)AVR_CORO_RUNNING;
-    coro->data = data == NULL ? NULL : *data;
-    avr_swapcontext(&coro->ret, &coro->exec);
+    value = avr_coro_resume_unchecked(coro, data == NULL ? NULL : *data);
     if (data != NULL)
     {
-        *data = coro->data;
+        *data = value;
     }
     return 0;
 }
 
 int avr_coro_yield(avr_coro_t *self, void **data)
 {
+    void *value;
     if (self == NULL || self->status != (char)AVR_CORO_RUNNING)
     {
         return 1;
     }
-    self->status = (char)AVR_CORO_SUSPENDED;
-    self->data = data == NULL ? NULL : *data;
-    avr_swapcontext(&self->exec, &self->ret);
+    value = avr_coro_yield_unchecked(self, data == NULL ? NULL : *data);
     if (data != NULL)
     {
-        *data = self->data;
+        *data = value;
     }
     return 0;
 }
@@ -81,6 +224,20 @@ avr_coro_state_t avr_coro_state(const avr_coro_t *coro)
     return coro == NULL || coro->status < AVR_CORO_SUSPENDED || coro->status >= AVR_CORO_ILLEGAL ? AVR_CORO_ILLEGAL : (avr_coro_state_t)coro->status;
 }
 
+#if AVR_CONTEXT_STACK_PAINT
+size_t avr_coro_stack_used(const avr_coro_t *coro)
+{
+    return coro == NULL ? 0 : avr_stack_used(coro->stackp, coro->stack_size);
+}
+#endif /* AVR_CONTEXT_STACK_PAINT */
+
+#if AVR_CONTEXT_STATS
+int avr_coro_stats(const avr_coro_t *coro, avr_stats_t *snapshot)
+{
+    return coro == NULL ? 1 : avr_stats_read(&coro->stats, snapshot);
+}
+#endif /* AVR_CONTEXT_STATS */
+
 #endif /* __AVR__ */
 #endif /* AVRCORO_IMPL_H */
 
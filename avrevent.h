@@ -0,0 +1,83 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVREVENT_H
+#define AVREVENT_H
+
+#ifdef __AVR__
+
+/* Event definition. */
+typedef struct avr_event_t_ {
+    volatile uint8_t signalled;
+    avr_coro_t *waiter;
+} avr_event_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below make it possible for a coroutine to wait for an
+interrupt without polling.
+
+An event is represented by the "avr_event_t" data type. It should be
+treated as an opaque data type. An event gets signalled from within
+an interrupt routine by the AVR_EVENT_SIGNAL macro (see below), which
+takes a few cycles and does not switch contexts. The coroutine waiting
+for the event gets resumed by the invoker on its next pass, by calling
+avr_event_dispatch(). The signals do not get queued: signalling an
+event which is already signalled has no effect.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with one exception: avr_event_dispatch()
+returns 1 if it has resumed the waiting coroutine, or 0 otherwise.
+
+The function avr_event_init() initialises an event represented by a
+structure pointed at by "ev" in the non-signalled state.
+
+The function avr_event_wait() suspends the currently running coroutine
+"self" until the event gets signalled, unless it is already signalled.
+The event becomes non-signalled when the function returns. Only one
+coroutine may wait for an event at a time.
+
+The function avr_event_signal() is a function counterpart of the
+AVR_EVENT_SIGNAL macro.
+
+The function avr_event_dispatch() resumes the coroutine waiting for
+the event if the event is signalled. It is meant to be called by the
+invoker of the coroutine, e.g.:
+
+for (;;)
+{
+    avr_event_dispatch(&rx_event);
+    avr_event_dispatch(&button_event);
+}
+*/
+extern int avr_event_init(avr_event_t *ev);
+extern int avr_event_wait(avr_event_t *ev, avr_coro_t *self);
+extern int avr_event_signal(avr_event_t *ev);
+extern int avr_event_dispatch(avr_event_t *ev);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+/*
+AVR_EVENT_SIGNAL macro signals the event pointed at by 'ev'. It is
+safe to use from within interrupt routines, and it compiles to a
+single store, so it does not make the routine save any extra
+registers.
+
+Example:
+
+ISR(PCINT0_vect)
+{
+    AVR_EVENT_SIGNAL(&button_event);
+}
+*/
+#define AVR_EVENT_SIGNAL(ev) ((void)((ev)->signalled = 1))
+
+#endif /* __AVR__ */
+#endif /* AVREVENT_H */
@@ -0,0 +1,70 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the event functions.
+It meant to be included after 'avrevent.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVREVENT_IMPL_H
+#define AVREVENT_IMPL_H
+
+#ifdef __AVR__
+
+int avr_event_init(avr_event_t *ev)
+{
+    if (ev == NULL)
+    {
+        return 1;
+    }
+    ev->signalled = 0;
+    ev->waiter = NULL;
+    return 0;
+}
+
+int avr_event_wait(avr_event_t *ev, avr_coro_t *self)
+{
+    if (ev == NULL || self == NULL || (ev->waiter != NULL && ev->waiter != self))
+    {
+        return 1;
+    }
+    ev->waiter = self;
+    while (!ev->signalled)
+    {
+        avr_coro_yield(self, NULL);
+    }
+    ev->waiter = NULL;
+    /* A single byte store: an interrupt cannot split it. A signal
+     * which arrives after the check above merges with this one. */
+    ev->signalled = 0;
+    return 0;
+}
+
+int avr_event_signal(avr_event_t *ev)
+{
+    if (ev == NULL)
+    {
+        return 1;
+    }
+    AVR_EVENT_SIGNAL(ev);
+    return 0;
+}
+
+int avr_event_dispatch(avr_event_t *ev)
+{
+    avr_coro_t *waiter;
+    if (ev == NULL || !ev->signalled || (waiter = ev->waiter) == NULL)
+    {
+        return 0;
+    }
+    avr_coro_resume(waiter, NULL);
+    return 1;
+}
+
+#endif /* __AVR__ */
+#endif /* AVREVENT_IMPL_H */
@@ -0,0 +1,211 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRIO_H
+#define AVRIO_H
+
+#ifdef __AVR__
+
+/*
+The drivers below are available on the classic AVR devices which have
+the corresponding peripherals: USART0 (UART), SPI and TWI (I2C). The
+megaAVR peripherals are not supported.
+
+AVR_UART_RX_BUFFER_SIZE - the size of the UART receive buffer, in
+bytes, a power of two not greater than 256. It may be defined before
+including this file, 32 by default.
+*/
+#if defined(UDR0)
+#define AVR_IO_UART 1
+#else
+#define AVR_IO_UART 0
+#endif /* UDR0 */
+
+#if defined(SPDR)
+#define AVR_IO_SPI 1
+#else
+#define AVR_IO_SPI 0
+#endif /* SPDR */
+
+#if defined(TWDR)
+#define AVR_IO_TWI 1
+#else
+#define AVR_IO_TWI 0
+#endif /* TWDR */
+
+#ifndef AVR_UART_RX_BUFFER_SIZE
+#define AVR_UART_RX_BUFFER_SIZE 32
+#endif /* AVR_UART_RX_BUFFER_SIZE */
+
+#if (AVR_UART_RX_BUFFER_SIZE & (AVR_UART_RX_BUFFER_SIZE - 1)) != 0 || AVR_UART_RX_BUFFER_SIZE > 256
+#error "AVR_UART_RX_BUFFER_SIZE should be a power of two not greater than 256."
+#endif
+
+#if defined(USART0_RX_vect)
+#define AVR_UART_RX_VECTOR USART0_RX_vect
+#define AVR_UART_UDRE_VECTOR USART0_UDRE_vect
+#else
+#define AVR_UART_RX_VECTOR USART_RX_vect
+#define AVR_UART_UDRE_VECTOR USART_UDRE_vect
+#endif /* USART0_RX_vect */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement interrupt driven UART, SPI and TWI
+drivers for coroutines. Instead of busy-waiting on the peripheral
+flags, a driver function starts the transfer and suspends the calling
+coroutine "self" until the interrupt routine of the driver reports its
+completion through an event (see avrevent.h). Meanwhile, the invoker
+could run other coroutines, e.g. to overlap the transfers on the
+different buses.
+
+Every driver has its own event: avr_uart_rx_event, avr_uart_tx_event,
+avr_spi_event and avr_twi_event. The invoker should either resume the
+waiting coroutines with avr_event_dispatch(), e.g.:
+
+for (;;)
+{
+    avr_event_dispatch(&avr_twi_event);
+    avr_event_dispatch(&avr_spi_event);
+}
+
+or just keep resuming them: a coroutine which has been resumed before
+its transfer is complete yields again (passing the "NULL" value as
+data).
+
+If another coroutine is using the same driver, the function yields
+until it is done. The buffers get accessed by the interrupt routines
+directly, without copying, so they should remain intact until the
+function returns.
+
+The drivers do not define the interrupt routines by themselves, so
+that they do not conflict with the Arduino libraries. The ones which
+are used should be defined by the macros below.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with one exception:
+avr_uart_available() returns the number of the received bytes.
+
+UART:
+
+The function avr_uart_init() configures USART0 for the "baud" rate
+(8 data bits, no parity, 1 stop bit), enables the transmitter, the
+receiver and the receive interrupt. It should not be used along with
+the Arduino Serial object.
+
+The function avr_uart_write() transmits "len" bytes from "buf". It
+returns when the last byte has been handed over to the hardware.
+
+The function avr_uart_read() receives "len" bytes into "buf". The
+received bytes get buffered by the interrupt routine (see
+AVR_UART_RX_BUFFER_SIZE), so no data is lost between the calls unless
+the buffer overflows. The bytes which do not fit get dropped.
+
+The function avr_uart_available() returns the number of the received
+bytes which could be read without waiting.
+
+SPI:
+
+The function avr_spi_init() enables the SPI in the master mode. The
+"spcr" value sets the rest of the SPCR bits (CPOL, CPHA, DORD, SPR1,
+SPR0), and the "spsr" one sets the SPI2X bit of SPSR. The pins (SS,
+SCK, MOSI) should be configured by the application, e.g. by
+SPI.begin(). The slave select pins are the responsibility of the
+application too.
+
+The function avr_spi_transfer() sends "len" bytes from "tx_buf" and
+stores the bytes received meanwhile into "rx_buf". Either of the
+buffers may be "NULL": then the 0xFF bytes get sent, or the received
+bytes get discarded. Please keep in mind that an interrupt takes a few
+dozens of cycles, so at the highest SPI clock rates the transfer gets
+slower than a busy-waiting one. This driver pays off at the lower
+clock rates, when the other coroutines could use the time.
+
+TWI:
+
+The function avr_twi_init() enables the TWI in the master mode with
+the "freq" SCL frequency, in Hz. It fails if the frequency cannot be
+set with the prescaler value of 1. The pull-ups should be provided
+by the application (e.g. Wire.begin() enables the internal ones).
+
+The function avr_twi_write_read() writes "wlen" bytes from "wbuf" to
+the slave device with the 7-bit address "addr", then issues a repeated
+START and reads "rlen" bytes into "rbuf". It is the usual way to read
+the registers of a sensor. Either of the phases may be empty. It fails
+if the device does not acknowledge its address or the written data,
+or if the bus arbitration gets lost. Writing zero bytes (without
+reading) checks if a device is present at the address.
+
+The functions avr_twi_write() and avr_twi_read() perform only one of
+the phases.
+*/
+#if AVR_IO_UART
+extern avr_event_t avr_uart_rx_event;
+extern avr_event_t avr_uart_tx_event;
+extern int avr_uart_init(uint32_t baud);
+extern int avr_uart_write(avr_coro_t *self, const void *buf, size_t len);
+extern int avr_uart_read(avr_coro_t *self, void *buf, size_t len);
+extern size_t avr_uart_available(void);
+extern void avr_uart_rx_isr(void);
+extern void avr_uart_udre_isr(void);
+#endif /* AVR_IO_UART */
+
+#if AVR_IO_SPI
+extern avr_event_t avr_spi_event;
+extern int avr_spi_init(uint8_t spcr, uint8_t spsr);
+extern int avr_spi_transfer(avr_coro_t *self, const void *tx_buf, void *rx_buf, size_t len);
+extern void avr_spi_isr(void);
+#endif /* AVR_IO_SPI */
+
+#if AVR_IO_TWI
+extern avr_event_t avr_twi_event;
+extern int avr_twi_init(uint32_t freq);
+extern int avr_twi_write_read(avr_coro_t *self, uint8_t addr,
+                              const void *wbuf, size_t wlen,
+                              void *rbuf, size_t rlen);
+extern int avr_twi_write(avr_coro_t *self, uint8_t addr, const void *buf, size_t len);
+extern int avr_twi_read(avr_coro_t *self, uint8_t addr, void *buf, size_t len);
+extern void avr_twi_isr(void);
+#endif /* AVR_IO_TWI */
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+/*
+AVR_UART_ISR, AVR_SPI_ISR and AVR_TWI_ISR macros define the interrupt
+routines of the drivers. Each of them should be used once across the
+project, at the file scope, after including <avr/interrupt.h>, if the
+driver is used:
+
+AVR_TWI_ISR()
+*/
+#define AVR_UART_ISR()                                                  \
+    ISR(AVR_UART_RX_VECTOR)                                             \
+    {                                                                   \
+        avr_uart_rx_isr();                                              \
+    }                                                                   \
+    ISR(AVR_UART_UDRE_VECTOR)                                           \
+    {                                                                   \
+        avr_uart_udre_isr();                                            \
+    }
+
+#define AVR_SPI_ISR()                                                   \
+    ISR(SPI_STC_vect)                                                   \
+    {                                                                   \
+        avr_spi_isr();                                                  \
+    }
+
+#define AVR_TWI_ISR()                                                   \
+    ISR(TWI_vect)                                                       \
+    {                                                                   \
+        avr_twi_isr();                                                  \
+    }
+
+#endif /* __AVR__ */
+#endif /* AVRIO_H */
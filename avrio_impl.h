@@ -0,0 +1,352 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the coroutine driver functions.
+It meant to be included after 'avrio.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRIO_IMPL_H
+#define AVRIO_IMPL_H
+
+#ifdef __AVR__
+
+#if AVR_IO_UART || AVR_IO_SPI || AVR_IO_TWI
+/* Wait until no other coroutine uses the driver, then take it. The
+ * flags are only touched by the coroutines. */
+static void avr_io_acquire(volatile uint8_t *busy, avr_coro_t *self)
+{
+    while (*busy)
+    {
+        avr_coro_yield(self, NULL);
+    }
+    *busy = 1;
+}
+#endif /* AVR_IO_UART || AVR_IO_SPI || AVR_IO_TWI */
+
+#if AVR_IO_UART
+avr_event_t avr_uart_rx_event;
+avr_event_t avr_uart_tx_event;
+
+static uint8_t avr_uart_rx_buf[AVR_UART_RX_BUFFER_SIZE];
+static volatile uint8_t avr_uart_rx_head; /* written by the interrupt routine */
+static volatile uint8_t avr_uart_rx_tail;
+static const uint8_t *volatile avr_uart_tx_ptr;
+static volatile size_t avr_uart_tx_len;
+static volatile uint8_t avr_uart_rx_busy;
+static volatile uint8_t avr_uart_tx_busy;
+
+int avr_uart_init(uint32_t baud)
+{
+    uint32_t ubrr;
+    if (baud == 0)
+    {
+        return 1;
+    }
+    /* double speed mode: UBRR = F_CPU / (8 * baud) - 1, rounded */
+    ubrr = ((uint32_t)F_CPU + baud * 4) / (baud * 8);
+    if (ubrr == 0 || ubrr > 4096)
+    {
+        return 1;
+    }
+    UCSR0B = 0;
+    avr_event_init(&avr_uart_rx_event);
+    avr_event_init(&avr_uart_tx_event);
+    avr_uart_rx_head = avr_uart_rx_tail = 0;
+    avr_uart_tx_len = 0;
+    avr_uart_rx_busy = avr_uart_tx_busy = 0;
+    UBRR0 = (uint16_t)(ubrr - 1);
+    UCSR0A = 1 << U2X0;
+    UCSR0C = 1 << UCSZ01 | 1 << UCSZ00; /* 8N1 */
+    UCSR0B = 1 << RXEN0 | 1 << TXEN0 | 1 << RXCIE0;
+    return 0;
+}
+
+int avr_uart_write(avr_coro_t *self, const void *buf, size_t len)
+{
+    if (self == NULL || (buf == NULL && len != 0))
+    {
+        return 1;
+    }
+    if (len == 0)
+    {
+        return 0;
+    }
+    avr_io_acquire(&avr_uart_tx_busy, self);
+    avr_uart_tx_ptr = (const uint8_t *)buf;
+    avr_uart_tx_len = len;
+    /* The data register empty interrupt is disabled at this point. */
+    UCSR0B |= 1 << UDRIE0;
+    avr_event_wait(&avr_uart_tx_event, self);
+    avr_uart_tx_busy = 0;
+    return 0;
+}
+
+int avr_uart_read(avr_coro_t *self, void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    uint8_t tail;
+    if (self == NULL || (buf == NULL && len != 0))
+    {
+        return 1;
+    }
+    avr_io_acquire(&avr_uart_rx_busy, self);
+    tail = avr_uart_rx_tail;
+    while (len != 0)
+    {
+        if (tail == avr_uart_rx_head)
+        {
+            /* A byte received after the check signals the event, so
+             * the wait returns right away. */
+            avr_event_wait(&avr_uart_rx_event, self);
+            continue;
+        }
+        *p++ = avr_uart_rx_buf[tail];
+        tail = (uint8_t)((tail + 1) & (AVR_UART_RX_BUFFER_SIZE - 1));
+        avr_uart_rx_tail = tail;
+        len--;
+    }
+    avr_uart_rx_busy = 0;
+    return 0;
+}
+
+size_t avr_uart_available(void)
+{
+    return (uint8_t)(avr_uart_rx_head - avr_uart_rx_tail) & (AVR_UART_RX_BUFFER_SIZE - 1);
+}
+
+void avr_uart_rx_isr(void)
+{
+    const uint8_t data = UDR0;
+    const uint8_t head = avr_uart_rx_head;
+    const uint8_t next = (uint8_t)((head + 1) & (AVR_UART_RX_BUFFER_SIZE - 1));
+    if (next != avr_uart_rx_tail)
+    {
+        avr_uart_rx_buf[head] = data;
+        avr_uart_rx_head = next;
+    }
+    AVR_EVENT_SIGNAL(&avr_uart_rx_event);
+}
+
+void avr_uart_udre_isr(void)
+{
+    const uint8_t *p = avr_uart_tx_ptr;
+    UDR0 = *p++;
+    avr_uart_tx_ptr = p;
+    if (--avr_uart_tx_len == 0)
+    {
+        UCSR0B &= (uint8_t)~(1 << UDRIE0);
+        AVR_EVENT_SIGNAL(&avr_uart_tx_event);
+    }
+}
+#endif /* AVR_IO_UART */
+
+#if AVR_IO_SPI
+avr_event_t avr_spi_event;
+
+static const uint8_t *volatile avr_spi_tx_ptr;
+static uint8_t *volatile avr_spi_rx_ptr;
+static volatile size_t avr_spi_len;
+static volatile uint8_t avr_spi_busy;
+
+int avr_spi_init(uint8_t spcr, uint8_t spsr)
+{
+    avr_event_init(&avr_spi_event);
+    avr_spi_busy = 0;
+    SPCR = (uint8_t)((spcr & ~(1 << SPIE)) | 1 << SPE | 1 << MSTR);
+    SPSR = spsr & (1 << SPI2X);
+    return 0;
+}
+
+int avr_spi_transfer(avr_coro_t *self, const void *tx_buf, void *rx_buf, size_t len)
+{
+    const uint8_t *tx = (const uint8_t *)tx_buf;
+    if (self == NULL)
+    {
+        return 1;
+    }
+    if (len == 0)
+    {
+        return 0;
+    }
+    avr_io_acquire(&avr_spi_busy, self);
+    avr_spi_tx_ptr = tx != NULL ? tx + 1 : NULL;
+    avr_spi_rx_ptr = (uint8_t *)rx_buf;
+    avr_spi_len = len;
+    SPCR |= 1 << SPIE;
+    SPDR = tx != NULL ? *tx : 0xFF;
+    avr_event_wait(&avr_spi_event, self);
+    avr_spi_busy = 0;
+    return 0;
+}
+
+void avr_spi_isr(void)
+{
+    const uint8_t data = SPDR;
+    uint8_t *rx = avr_spi_rx_ptr;
+    const uint8_t *tx = avr_spi_tx_ptr;
+    if (rx != NULL)
+    {
+        *rx++ = data;
+        avr_spi_rx_ptr = rx;
+    }
+    if (--avr_spi_len == 0)
+    {
+        SPCR &= (uint8_t)~(1 << SPIE);
+        AVR_EVENT_SIGNAL(&avr_spi_event);
+        return;
+    }
+    if (tx != NULL)
+    {
+        SPDR = *tx++;
+        avr_spi_tx_ptr = tx;
+    }
+    else
+    {
+        SPDR = 0xFF;
+    }
+}
+#endif /* AVR_IO_SPI */
+
+#if AVR_IO_TWI
+avr_event_t avr_twi_event;
+
+static volatile uint8_t avr_twi_sla; /* the address shifted to the left */
+static const uint8_t *volatile avr_twi_wptr;
+static volatile size_t avr_twi_wlen;
+static uint8_t *volatile avr_twi_rptr;
+static volatile size_t avr_twi_rlen;
+static volatile uint8_t avr_twi_result;
+static volatile uint8_t avr_twi_busy;
+
+/* TWCR values: continue, continue acknowledging the received byte,
+ * (repeated) START, STOP. */
+#define AVR_TWI_NEXT (1 << TWINT | 1 << TWEN | 1 << TWIE)
+#define AVR_TWI_NEXT_ACK (AVR_TWI_NEXT | 1 << TWEA)
+#define AVR_TWI_START (AVR_TWI_NEXT | 1 << TWSTA)
+#define AVR_TWI_STOP (1 << TWINT | 1 << TWEN | 1 << TWSTO)
+
+int avr_twi_init(uint32_t freq)
+{
+    uint32_t div;
+    if (freq == 0)
+    {
+        return 1;
+    }
+    /* SCL = F_CPU / (16 + 2 * TWBR) with the prescaler value of 1 */
+    div = (uint32_t)F_CPU / freq;
+    if (div < 16 || (div - 16) / 2 > 255)
+    {
+        return 1;
+    }
+    avr_event_init(&avr_twi_event);
+    avr_twi_busy = 0;
+    TWSR = 0;
+    TWBR = (uint8_t)((div - 16) / 2);
+    TWCR = 1 << TWEN;
+    return 0;
+}
+
+int avr_twi_write_read(avr_coro_t *self, uint8_t addr,
+                       const void *wbuf, size_t wlen,
+                       void *rbuf, size_t rlen)
+{
+    uint8_t result;
+    if (self == NULL || addr > 0x7F ||
+        (wbuf == NULL && wlen != 0) || (rbuf == NULL && rlen != 0))
+    {
+        return 1;
+    }
+    avr_io_acquire(&avr_twi_busy, self);
+    /* The STOP condition of the previous transfer takes a few SCL
+     * periods to complete. */
+    while (TWCR & (1 << TWSTO))
+    {
+    }
+    avr_twi_sla = (uint8_t)(addr << 1);
+    avr_twi_wptr = (const uint8_t *)wbuf;
+    avr_twi_wlen = wlen;
+    avr_twi_rptr = (uint8_t *)rbuf;
+    avr_twi_rlen = rlen;
+    avr_twi_result = 1;
+    TWCR = AVR_TWI_START;
+    avr_event_wait(&avr_twi_event, self);
+    result = avr_twi_result;
+    avr_twi_busy = 0;
+    return result;
+}
+
+int avr_twi_write(avr_coro_t *self, uint8_t addr, const void *buf, size_t len)
+{
+    return avr_twi_write_read(self, addr, buf, len, NULL, 0);
+}
+
+int avr_twi_read(avr_coro_t *self, uint8_t addr, void *buf, size_t len)
+{
+    return avr_twi_write_read(self, addr, NULL, 0, buf, len);
+}
+
+static void avr_twi_finish(uint8_t twcr, uint8_t result)
+{
+    TWCR = twcr;
+    avr_twi_result = result;
+    AVR_EVENT_SIGNAL(&avr_twi_event);
+}
+
+void avr_twi_isr(void)
+{
+    switch (TWSR & 0xF8)
+    {
+        case 0x08: /* START transmitted */
+        case 0x10: /* repeated START transmitted */
+            /* An empty write addresses the device only. */
+            TWDR = avr_twi_wlen != 0 || avr_twi_rlen == 0 ? avr_twi_sla : avr_twi_sla | 1;
+            TWCR = AVR_TWI_NEXT;
+            break;
+        case 0x18: /* SLA+W transmitted, ACK received */
+        case 0x28: /* data transmitted, ACK received */
+            if (avr_twi_wlen != 0)
+            {
+                TWDR = *avr_twi_wptr++;
+                avr_twi_wlen--;
+                TWCR = AVR_TWI_NEXT;
+            }
+            else if (avr_twi_rlen != 0)
+            {
+                TWCR = AVR_TWI_START;
+            }
+            else
+            {
+                avr_twi_finish(AVR_TWI_STOP, 0);
+            }
+            break;
+        case 0x40: /* SLA+R transmitted, ACK received */
+            TWCR = avr_twi_rlen > 1 ? AVR_TWI_NEXT_ACK : AVR_TWI_NEXT;
+            break;
+        case 0x50: /* data received, ACK returned */
+            *avr_twi_rptr++ = TWDR;
+            avr_twi_rlen--;
+            TWCR = avr_twi_rlen > 1 ? AVR_TWI_NEXT_ACK : AVR_TWI_NEXT;
+            break;
+        case 0x58: /* data received, NACK returned: the last byte */
+            *avr_twi_rptr++ = TWDR;
+            avr_twi_rlen--;
+            avr_twi_finish(AVR_TWI_STOP, 0);
+            break;
+        case 0x38: /* arbitration lost: release the bus */
+            avr_twi_finish(1 << TWINT | 1 << TWEN, 1);
+            break;
+        default: /* NACK on address or data, bus error */
+            avr_twi_finish(AVR_TWI_STOP, 1);
+            break;
+    }
+}
+#endif /* AVR_IO_TWI */
+
+#endif /* __AVR__ */
+#endif /* AVRIO_IMPL_H */
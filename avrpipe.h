@@ -0,0 +1,116 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRPIPE_H
+#define AVRPIPE_H
+
+#ifdef __AVR__
+
+/* Buffer descriptor definition. The payload never gets copied: the
+ * descriptors get passed from one stage to the other. */
+typedef struct avr_buf_t_ {
+    struct avr_buf_t_ *next; /* queue links */
+    uint8_t *datap;
+    size_t size; /* the size of the memory region */
+    size_t len; /* the length of the payload */
+} avr_buf_t;
+
+/* Pipeline stage definition. The coroutine MUST remain the first
+ * member: a pointer to a stage coroutine is used as a pointer to the
+ * stage. */
+typedef struct avr_pipe_stage_t_ {
+    avr_coro_t coro;
+    avr_buf_t *head; /* the input queue */
+    avr_buf_t *tail;
+} avr_pipe_stage_t;
+
+/* Pipeline definition. */
+typedef struct avr_pipe_t_ {
+    avr_pipe_stage_t *stages;
+    uint8_t nstages;
+    avr_buf_t *free; /* the free list */
+} avr_pipe_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement zero-copy pipelines on top of the
+coroutines facility. A pipeline is a chain of stages, every stage is
+a coroutine. The first stage (the producer) takes buffers from the
+free list of the pipeline and fills them, every next stage processes
+the buffers it receives from the previous one in place, and the last
+stage (the consumer) returns them to the free list. Only the buffer
+descriptors ("avr_buf_t") get passed from one stage to the other, so
+the payload never gets copied.
+
+A stage waits by calling avr_coro_yield(), passing the "NULL" value
+as data. The function avr_pipe_run() gives every stage a turn, and a
+stage runs until it has to wait: for a free buffer or for an input
+buffer. The free list is bounded by the number of buffers, so the
+producer cannot get ahead of the rest of the stages for more than
+that.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with the following exceptions:
+avr_pipe_alloc() and avr_pipe_recv() return a buffer descriptor or
+"NULL", avr_pipe_run() returns the number of the stages which are not
+dead yet.
+
+The function avr_pipe_init() initialises a pipeline represented by a
+structure pointed at by "pipe" which consists of "nstages" stages
+pointed at by "stages". The free list is empty initially.
+
+The function avr_pipe_stage_init() initialises the stage "index" of the
+pipeline. Upon the first turn, the function "func" gets called with
+two arguments applied: a pointer to the coroutine of the stage
+("self") and a pointer to the pipeline. The caller must allocate a
+stack for the stage (stackp, stack_size).
+
+The function avr_pipe_add_buffer() initialises a buffer descriptor
+pointed at by "buf" to refer to the memory region (datap, size) and
+puts it into the free list.
+
+The function avr_pipe_alloc() takes a buffer from the free list. If
+the list is empty, the stage "self" waits until some buffer gets
+freed. The length of the taken buffer is zero. If "self" is "NULL",
+the function does not wait and returns "NULL" when the free list is
+empty.
+
+The function avr_pipe_free() returns a buffer to the free list.
+
+The function avr_pipe_send() passes the ownership of a buffer to the
+stage following the stage "self". It fails if "self" is the last
+stage.
+
+The function avr_pipe_recv() takes a buffer from the input queue of
+the stage "self". If the queue is empty, the stage waits until the
+previous stage sends some buffer.
+
+The function avr_pipe_run() resumes every stage which is not dead
+once, starting from the first one.
+
+The pipelines are not protected against concurrent access, so they
+MUST NOT be used from within interrupt routines.
+*/
+extern int avr_pipe_init(avr_pipe_t *pipe, avr_pipe_stage_t *stages, uint8_t nstages);
+extern int avr_pipe_stage_init(avr_pipe_t *pipe, uint8_t index,
+                               void *stackp, const size_t stack_size,
+                               avr_coro_func_t func);
+extern int avr_pipe_add_buffer(avr_pipe_t *pipe, avr_buf_t *buf,
+                               void *datap, const size_t size);
+extern avr_buf_t *avr_pipe_alloc(avr_pipe_t *pipe, avr_coro_t *self);
+extern int avr_pipe_free(avr_pipe_t *pipe, avr_buf_t *buf);
+extern int avr_pipe_send(avr_pipe_t *pipe, avr_coro_t *self, avr_buf_t *buf);
+extern avr_buf_t *avr_pipe_recv(avr_pipe_t *pipe, avr_coro_t *self);
+extern uint8_t avr_pipe_run(avr_pipe_t *pipe);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+#endif /* __AVR__ */
+#endif /* AVRPIPE_H */
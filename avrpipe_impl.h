@@ -0,0 +1,164 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the pipeline functions.
+It meant to be included after 'avrpipe.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRPIPE_IMPL_H
+#define AVRPIPE_IMPL_H
+
+#ifdef __AVR__
+
+int avr_pipe_init(avr_pipe_t *pipe, avr_pipe_stage_t *stages, uint8_t nstages)
+{
+    uint8_t i;
+    if (pipe == NULL || stages == NULL || nstages == 0)
+    {
+        return 1;
+    }
+    pipe->stages = stages;
+    pipe->nstages = nstages;
+    pipe->free = NULL;
+    for (i = 0; i < nstages; i++)
+    {
+        stages[i].head = NULL;
+        stages[i].tail = NULL;
+    }
+    return 0;
+}
+
+int avr_pipe_stage_init(avr_pipe_t *pipe, uint8_t index,
+                        void *stackp, const size_t stack_size,
+                        avr_coro_func_t funcp)
+{
+    if (pipe == NULL || index >= pipe->nstages)
+    {
+        return 1;
+    }
+    return avr_coro_init(&pipe->stages[index].coro, stackp, stack_size, funcp);
+}
+
+int avr_pipe_add_buffer(avr_pipe_t *pipe, avr_buf_t *buf,
+                        void *datap, const size_t size)
+{
+    if (pipe == NULL || buf == NULL || datap == NULL)
+    {
+        return 1;
+    }
+    buf->datap = (uint8_t *)datap;
+    buf->size = size;
+    return avr_pipe_free(pipe, buf);
+}
+
+avr_buf_t *avr_pipe_alloc(avr_pipe_t *pipe, avr_coro_t *self)
+{
+    avr_buf_t *buf;
+    if (pipe == NULL)
+    {
+        return NULL;
+    }
+    while (pipe->free == NULL)
+    {
+        if (self == NULL)
+        {
+            return NULL;
+        }
+        /* let the rest of the stages free some buffers */
+        avr_coro_yield(self, NULL);
+    }
+    buf = pipe->free;
+    pipe->free = buf->next;
+    buf->len = 0;
+    return buf;
+}
+
+int avr_pipe_free(avr_pipe_t *pipe, avr_buf_t *buf)
+{
+    if (pipe == NULL || buf == NULL)
+    {
+        return 1;
+    }
+    buf->next = pipe->free;
+    pipe->free = buf;
+    return 0;
+}
+
+int avr_pipe_send(avr_pipe_t *pipe, avr_coro_t *self, avr_buf_t *buf)
+{
+    avr_pipe_stage_t *next;
+    if (pipe == NULL || self == NULL || buf == NULL ||
+        (avr_pipe_stage_t *)self < pipe->stages ||
+        (avr_pipe_stage_t *)self >= pipe->stages + pipe->nstages - 1)
+    {
+        return 1;
+    }
+    next = (avr_pipe_stage_t *)self + 1;
+    buf->next = NULL;
+    if (next->tail == NULL)
+    {
+        next->head = buf;
+    }
+    else
+    {
+        next->tail->next = buf;
+    }
+    next->tail = buf;
+    return 0;
+}
+
+avr_buf_t *avr_pipe_recv(avr_pipe_t *pipe, avr_coro_t *self)
+{
+    avr_pipe_stage_t *stage = (avr_pipe_stage_t *)self;
+    avr_buf_t *buf;
+    if (pipe == NULL || stage < pipe->stages || stage >= pipe->stages + pipe->nstages)
+    {
+        return NULL;
+    }
+    while (stage->head == NULL)
+    {
+        /* let the previous stages produce something */
+        avr_coro_yield(self, NULL);
+    }
+    buf = stage->head;
+    stage->head = buf->next;
+    if (stage->head == NULL)
+    {
+        stage->tail = NULL;
+    }
+    return buf;
+}
+
+uint8_t avr_pipe_run(avr_pipe_t *pipe)
+{
+    uint8_t i, alive = 0;
+    void *data;
+    if (pipe == NULL)
+    {
+        return 0;
+    }
+    for (i = 0; i < pipe->nstages; i++)
+    {
+        avr_coro_t *coro = &pipe->stages[i].coro;
+        if (avr_coro_state(coro) == AVR_CORO_DEAD)
+        {
+            continue;
+        }
+        data = (void *)pipe; /* gets passed to the stage function on the first turn */
+        avr_coro_resume(coro, &data);
+        if (avr_coro_state(coro) != AVR_CORO_DEAD)
+        {
+            alive++;
+        }
+    }
+    return alive;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRPIPE_IMPL_H */
@@ -0,0 +1,124 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRPROF_H
+#define AVRPROF_H
+
+#ifdef __AVR__
+
+/*
+Profiler configuration. The macro below may be defined before
+including this file (consistently across the project):
+
+AVR_PROF_BINS - the number of the histogram bins, 64 by default. Every
+bin takes two bytes of RAM.
+*/
+#ifndef AVR_PROF_BINS
+#define AVR_PROF_BINS 64
+#endif /* AVR_PROF_BINS */
+
+/* Character output function type used to dump the histogram. */
+typedef void (*avr_prof_putc_t)(char c);
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The context saved by the profiler interrupt routine (see
+AVR_PROF_ISR below).
+*/
+extern avr_context_t avr_prof_ctx;
+
+/*
+The functions below implement a sampling profiler on top of the
+context switching facility.
+
+A timer interrupt routine defined by AVR_PROF_ISR saves the context of
+the interrupted code with AVR_SAVE_CONTEXT and takes the program
+counter from its "pc" field (and "pc_ext" on the devices with 3-byte
+program counter, see AVR_CONTEXT_3_BYTE_PC). The program counter gets
+binned into a histogram of AVR_PROF_BINS equal address ranges, which
+covers the profiled region of the program memory. The samples outside
+of the region get counted separately. The bins saturate at 65535
+samples.
+
+As the interrupts are disabled while other interrupt routines run,
+the time spent in them gets attributed to the code they return to.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument).
+
+The function avr_prof_init() clears the histogram and sets up the
+profiled region of the program memory [lo, hi), in bytes. The width of
+a bin is the smallest power of two which makes AVR_PROF_BINS bins
+cover the region. E.g. avr_prof_init(0, FLASHEND + 1) profiles the
+whole program memory.
+
+The functions avr_prof_start() and avr_prof_stop() start and stop
+sampling. The application is responsible for configuring the timer.
+Please choose the sampling period which is not a multiple of the
+periods of the profiled code, to avoid aliasing.
+
+The function avr_prof_sample() adds the program counter saved in the
+context pointed at by "ctx" to the histogram if sampling is started. It
+gets called by the AVR_PROF_ISR. The interrupt routines which save the
+contexts on their own (e.g. the task scheduler tick) may call it too.
+It MUST be called with interrupts disabled.
+
+The function avr_prof_dump() writes the histogram as text using the
+"putc_func" function for every character. The output looks like this:
+
+# avr-prof
+range,0x000000,0x008000,512
+0x000200,37
+0x001a00,1204
+other,3
+total,1244
+# end
+
+The "range" line holds the profiled region and the width of the bins.
+Every next line holds the start address of a bin and the number of its
+samples (the empty bins are omitted). The addresses are byte addresses
+of the program memory, the same as in the ELF file symbol table, so
+they could be mapped to the functions with e.g. "avr-nm -n" output.
+Sampling should be stopped before dumping.
+*/
+extern int avr_prof_init(uint32_t lo, uint32_t hi);
+extern int avr_prof_start(void);
+extern int avr_prof_stop(void);
+extern int avr_prof_sample(const avr_context_t *ctx);
+extern int avr_prof_dump(avr_prof_putc_t putc_func);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+/*
+AVR_PROF_ISR macro defines the profiler interrupt routine for the
+interrupt vector 'vector'. It should be used once across the project,
+at the file scope, after including <avr/interrupt.h>, e.g.:
+
+AVR_PROF_ISR(TIMER1_COMPA_vect)
+
+The interrupted code sees no difference: the whole context gets
+restored before returning from the routine.
+*/
+#define AVR_PROF_ISR(vector)                                            \
+    ISR(vector, ISR_NAKED)                                              \
+    {                                                                   \
+        AVR_SAVE_CONTEXT("",                                            \
+                         "ldi r30, lo8(avr_prof_ctx)\n"                 \
+                         "ldi r31, hi8(avr_prof_ctx)\n");               \
+        /* compiled code expects R1 to be zero */                       \
+        __asm__ __volatile__("clr r1\n");                               \
+        avr_prof_sample(&avr_prof_ctx);                                 \
+        AVR_RESTORE_CONTEXT("ldi r30, lo8(avr_prof_ctx)\n"              \
+                            "ldi r31, hi8(avr_prof_ctx)\n");            \
+        __asm__ __volatile__("reti\n");                                 \
+    }
+
+#endif /* __AVR__ */
+#endif /* AVRPROF_H */
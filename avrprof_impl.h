@@ -0,0 +1,176 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRPROF_IMPL_H
+#define AVRPROF_IMPL_H
+
+#ifdef __AVR__
+
+avr_context_t avr_prof_ctx;
+
+/* The program counter in words: it is 22 bits wide on the devices with
+ * more than 128K of program memory. */
+#if AVR_CONTEXT_3_BYTE_PC
+typedef uint32_t avr_prof_pc_t;
+#else
+typedef uint16_t avr_prof_pc_t;
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+
+/* The histogram and the profiled region [lo, last], in words (the
+ * program counter counts words). */
+static uint16_t avr_prof_bins[AVR_PROF_BINS];
+static uint16_t avr_prof_other;
+static uint32_t avr_prof_total;
+static avr_prof_pc_t avr_prof_lo;
+static avr_prof_pc_t avr_prof_last;
+static uint8_t avr_prof_shift;
+static volatile uint8_t avr_prof_running;
+
+int avr_prof_init(uint32_t lo, uint32_t hi)
+{
+    uint8_t sreg;
+    uint16_t i;
+    uint32_t span;
+    if (lo >= hi)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    avr_prof_lo = (avr_prof_pc_t)(lo >> 1);
+    avr_prof_last = (avr_prof_pc_t)(((hi + 1) >> 1) - 1);
+    span = (uint32_t)(avr_prof_last - avr_prof_lo) + 1;
+    avr_prof_shift = 0;
+    while ((span - 1) >> avr_prof_shift >= AVR_PROF_BINS)
+    {
+        avr_prof_shift++;
+    }
+    for (i = 0; i < AVR_PROF_BINS; i++)
+    {
+        avr_prof_bins[i] = 0;
+    }
+    avr_prof_other = 0;
+    avr_prof_total = 0;
+    __asm__ __volatile__("" ::: "memory");
+    SREG = sreg;
+    return 0;
+}
+
+int avr_prof_start(void)
+{
+    avr_prof_running = 1;
+    return 0;
+}
+
+int avr_prof_stop(void)
+{
+    avr_prof_running = 0;
+    return 0;
+}
+
+int avr_prof_sample(const avr_context_t *ctx)
+{
+    avr_prof_pc_t pc;
+    uint16_t *counter;
+    if (ctx == NULL)
+    {
+        return 1;
+    }
+    if (!avr_prof_running)
+    {
+        return 0;
+    }
+    pc = (avr_prof_pc_t)(uint16_t)ctx->pc.ptr;
+#if AVR_CONTEXT_3_BYTE_PC
+    pc |= (avr_prof_pc_t)ctx->pc_ext << 16;
+#endif /* AVR_CONTEXT_3_BYTE_PC */
+    if (pc >= avr_prof_lo && pc <= avr_prof_last)
+    {
+        counter = &avr_prof_bins[(uint16_t)((pc - avr_prof_lo) >> avr_prof_shift)];
+    }
+    else
+    {
+        counter = &avr_prof_other;
+    }
+    if (*counter != UINT16_MAX)
+    {
+        (*counter)++;
+    }
+    avr_prof_total++;
+    return 0;
+}
+
+static void avr_prof_put_str(avr_prof_putc_t putc_func, const char *s)
+{
+    while (*s != '\0')
+    {
+        putc_func(*s++);
+    }
+}
+
+/* Byte address in the "0x%06lx" format. */
+static void avr_prof_put_hex(avr_prof_putc_t putc_func, uint32_t value)
+{
+    int8_t i;
+    putc_func('0');
+    putc_func('x');
+    for (i = 20; i >= 0; i -= 4)
+    {
+        const uint8_t digit = (uint8_t)(value >> i) & 0x0F;
+        putc_func((char)(digit < 10 ? '0' + digit : 'a' + digit - 10));
+    }
+}
+
+static void avr_prof_put_dec(avr_prof_putc_t putc_func, uint32_t value)
+{
+    char buf[10];
+    uint8_t n = 0;
+    do {
+        buf[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n != 0)
+    {
+        putc_func(buf[--n]);
+    }
+}
+
+int avr_prof_dump(avr_prof_putc_t putc_func)
+{
+    uint16_t i;
+    if (putc_func == NULL)
+    {
+        return 1;
+    }
+    avr_prof_put_str(putc_func, "# avr-prof\nrange,");
+    avr_prof_put_hex(putc_func, (uint32_t)avr_prof_lo << 1);
+    putc_func(',');
+    avr_prof_put_hex(putc_func, ((uint32_t)avr_prof_last + 1) << 1);
+    putc_func(',');
+    avr_prof_put_dec(putc_func, (uint32_t)2 << avr_prof_shift);
+    putc_func('\n');
+    for (i = 0; i < AVR_PROF_BINS; i++)
+    {
+        if (avr_prof_bins[i] == 0)
+        {
+            continue;
+        }
+        avr_prof_put_hex(putc_func, ((uint32_t)avr_prof_lo + ((uint32_t)i << avr_prof_shift)) << 1);
+        putc_func(',');
+        avr_prof_put_dec(putc_func, avr_prof_bins[i]);
+        putc_func('\n');
+    }
+    avr_prof_put_str(putc_func, "other,");
+    avr_prof_put_dec(putc_func, avr_prof_other);
+    avr_prof_put_str(putc_func, "\ntotal,");
+    avr_prof_put_dec(putc_func, avr_prof_total);
+    avr_prof_put_str(putc_func, "\n# end\n");
+    return 0;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRPROF_IMPL_H */
@@ -0,0 +1,126 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRRUNQ_H
+#define AVRRUNQ_H
+
+#ifdef __AVR__
+
+/* Wait queue definition. The waiting coroutines get linked through
+ * their own structures, so no memory gets allocated. */
+typedef struct avr_waitq_t_ {
+    avr_coro_t *head;
+    avr_coro_t *tail;
+    volatile uint8_t pending;
+} avr_waitq_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement a cooperative scheduler for coroutines,
+which resumes only the runnable ones.
+
+Every coroutine is kept on one of the three lists: the run queue
+(runnable coroutines), a wait queue (coroutines waiting to be woken
+up) or the list of dead coroutines. The lists are linked through the
+coroutine structures themselves (intrusive lists), so no memory gets
+allocated, and moving a coroutine between the lists takes a constant
+time. The blocked coroutines do not get resumed at all, so they cost
+nothing until they get woken up.
+
+A wait queue is represented by the "avr_waitq_t" data type. It should
+be treated as an opaque data type.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with a few exceptions: avr_runq_run()
+returns the number of the coroutines resumed, avr_runq_wake() returns
+1 if it has woken up a coroutine or 0 otherwise, avr_runq_reap()
+returns a dead coroutine or the "NULL" value, and avr_runq_empty()
+returns 1 if there are no runnable coroutines or 0 otherwise.
+
+The function avr_runq_add() puts the suspended coroutine "coro" at the
+end of the run queue. It fails if the coroutine is not suspended.
+
+The function avr_runq_run() resumes every coroutine which is runnable
+at the moment of the call once, in the order they have become
+runnable. It is meant to be called by the invoker of the coroutines,
+e.g. in the main loop. After the coroutine returns control:
+
+1. If it has yielded (by avr_coro_yield()), it gets put at the end of
+the run queue.
+
+2. If it has called avr_runq_wait(), it remains on the wait queue.
+
+3. If it has died, it gets put on the list of dead coroutines.
+
+The exchanged data pointers are always "NULL". The coroutines added or
+woken up during the pass get resumed on the next one. The function
+MUST NOT be called from within the scheduled coroutines.
+
+The function avr_waitq_init() initialises a wait queue represented by
+a structure pointed at by "wq".
+
+The function avr_runq_wait() suspends the currently running coroutine
+"self" (which MUST have been resumed by avr_runq_run()) on the wait
+queue "wq" until it gets woken up, unless there is a pending wake-up.
+
+The function avr_runq_wake() moves the coroutine which has been
+waiting the longest from the wait queue "wq" to the end of the run
+queue. If there are no waiting coroutines, the wake-up becomes
+pending, and the next avr_runq_wait() call on the queue consumes it
+and returns immediately. The wake-ups do not get counted: waking up
+an empty queue with a pending wake-up has no effect.
+
+The function avr_runq_wake_all() moves all of the waiting coroutines
+from the wait queue "wq" to the run queue at once, regardless of
+their number. It never makes a wake-up pending.
+
+The functions avr_runq_wake() and avr_runq_wake_all() are safe to
+call from within interrupt routines, as well as avr_runq_add() and
+avr_runq_empty().
+
+The function avr_runq_reap() removes a coroutine from the list of
+dead coroutines and returns it (or returns "NULL" if the list is
+empty), so that it could be re-initialised (e.g. by avr_coro_reset())
+and added again.
+
+The function avr_runq_empty() makes it possible to put the MCU to
+sleep when there is nothing to run, e.g.:
+
+for (;;)
+{
+    avr_runq_run();
+    cli();
+    if (avr_runq_empty())
+    {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+The coroutines on the lists MUST NOT be resumed (or transferred
+control to) by other means. The shared stack coroutines (see
+avrshared.h) cannot be scheduled.
+*/
+extern int avr_runq_add(avr_coro_t *coro);
+extern uint8_t avr_runq_run(void);
+extern int avr_waitq_init(avr_waitq_t *wq);
+extern int avr_runq_wait(avr_coro_t *self, avr_waitq_t *wq);
+extern int avr_runq_wake(avr_waitq_t *wq);
+extern int avr_runq_wake_all(avr_waitq_t *wq);
+extern avr_coro_t *avr_runq_reap(void);
+extern int avr_runq_empty(void);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+#endif /* __AVR__ */
+#endif /* AVRRUNQ_H */
@@ -0,0 +1,215 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the run queue functions.
+It meant to be included after 'avrrunq.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRRUNQ_IMPL_H
+#define AVRRUNQ_IMPL_H
+
+#ifdef __AVR__
+
+/* The run queue. It might be modified from within interrupt routines. */
+static avr_coro_t *volatile avr_runq_head;
+static avr_coro_t *volatile avr_runq_tail;
+/* The list of dead coroutines. */
+static avr_coro_t *avr_runq_dead;
+/* The coroutine resumed by avr_runq_run(). */
+static avr_coro_t *avr_runq_current;
+/* Set when the current coroutine gets suspended on a wait queue. */
+static uint8_t avr_runq_blocked;
+
+/* The interrupts MUST be disabled. */
+static void avr_runq_push(avr_coro_t *coro)
+{
+    coro->next = NULL;
+    if (avr_runq_tail != NULL)
+    {
+        avr_runq_tail->next = coro;
+    }
+    else
+    {
+        avr_runq_head = coro;
+    }
+    avr_runq_tail = coro;
+}
+
+int avr_runq_add(avr_coro_t *coro)
+{
+    uint8_t sreg;
+    if (coro == NULL || coro->status != (char)AVR_CORO_SUSPENDED)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    avr_runq_push(coro);
+    SREG = sreg;
+    return 0;
+}
+
+uint8_t avr_runq_run(void)
+{
+    avr_coro_t *coro, *batch;
+    uint8_t sreg, count = 0;
+    /* Take the whole queue: the coroutines which become runnable
+     * during the pass get queued anew. */
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    batch = avr_runq_head;
+    avr_runq_head = NULL;
+    avr_runq_tail = NULL;
+    SREG = sreg;
+    while (batch != NULL)
+    {
+        coro = batch;
+        batch = coro->next;
+        avr_runq_current = coro;
+        avr_runq_blocked = 0;
+        /* Every coroutine on the run queue is suspended. */
+        (void)avr_coro_resume_unchecked(coro, NULL);
+        avr_runq_current = NULL;
+        count++;
+        if (coro->status == (char)AVR_CORO_DEAD)
+        {
+            coro->next = avr_runq_dead;
+            avr_runq_dead = coro;
+        }
+        else if (!avr_runq_blocked)
+        {
+            sreg = SREG;
+            __asm__ __volatile__("cli\n" ::: "memory");
+            avr_runq_push(coro);
+            SREG = sreg;
+        }
+    }
+    return count;
+}
+
+int avr_waitq_init(avr_waitq_t *wq)
+{
+    if (wq == NULL)
+    {
+        return 1;
+    }
+    wq->head = NULL;
+    wq->tail = NULL;
+    wq->pending = 0;
+    return 0;
+}
+
+int avr_runq_wait(avr_coro_t *self, avr_waitq_t *wq)
+{
+    uint8_t sreg;
+    if (self == NULL || wq == NULL || self != avr_runq_current)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    if (wq->pending)
+    {
+        wq->pending = 0;
+        SREG = sreg;
+        return 0;
+    }
+    self->next = NULL;
+    if (wq->tail != NULL)
+    {
+        wq->tail->next = self;
+    }
+    else
+    {
+        wq->head = self;
+    }
+    wq->tail = self;
+    avr_runq_blocked = 1;
+    SREG = sreg;
+    /* An interrupt might move the coroutine to the run queue before
+     * it yields: it does not get resumed before avr_runq_run() gets
+     * control back anyway. */
+    (void)avr_coro_yield_unchecked(self, NULL);
+    return 0;
+}
+
+int avr_runq_wake(avr_waitq_t *wq)
+{
+    avr_coro_t *coro;
+    uint8_t sreg;
+    if (wq == NULL)
+    {
+        return 0;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    coro = wq->head;
+    if (coro != NULL)
+    {
+        wq->head = coro->next;
+        if (wq->head == NULL)
+        {
+            wq->tail = NULL;
+        }
+        avr_runq_push(coro);
+    }
+    else
+    {
+        wq->pending = 1;
+    }
+    SREG = sreg;
+    return coro != NULL;
+}
+
+int avr_runq_wake_all(avr_waitq_t *wq)
+{
+    uint8_t sreg;
+    if (wq == NULL)
+    {
+        return 1;
+    }
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    if (wq->head != NULL)
+    {
+        /* splice the whole wait queue */
+        if (avr_runq_tail != NULL)
+        {
+            avr_runq_tail->next = wq->head;
+        }
+        else
+        {
+            avr_runq_head = wq->head;
+        }
+        avr_runq_tail = wq->tail;
+        wq->head = NULL;
+        wq->tail = NULL;
+    }
+    SREG = sreg;
+    return 0;
+}
+
+avr_coro_t *avr_runq_reap(void)
+{
+    avr_coro_t *coro = avr_runq_dead;
+    if (coro != NULL)
+    {
+        avr_runq_dead = coro->next;
+        coro->next = NULL;
+    }
+    return coro;
+}
+
+int avr_runq_empty(void)
+{
+    return avr_runq_head == NULL;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRRUNQ_IMPL_H */
@@ -0,0 +1,443 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRSCHED_H
+#define AVRSCHED_H
+
+#ifdef __AVR__
+
+/* The number of task priorities (0 is the lowest one). */
+#define AVR_SCHED_PRIORITIES 8
+
+/*
+Tick source configuration. The macros below may be defined before
+including this file (consistently across the project) to choose the
+hardware timer which ticks for the scheduler and the tick rate:
+
+AVR_SCHED_TICK_SOURCE - one of the AVR_SCHED_TICK_* values below. By
+default, TCB0 is used on the megaAVR devices and Timer2 (or Timer1, if
+there is no Timer2) on the classic ones. Please keep in mind that on
+Arduino boards Timer0 is used for millis(), and TCA0 is used for PWM.
+
+AVR_SCHED_TICK_HZ - the tick rate in Hz, 1000 by default. The timer
+prescaler and the compare value get chosen at compile time from F_CPU.
+
+Idle configuration. When there are no ready tasks, the scheduler runs
+a built-in idle task which puts the MCU to sleep:
+
+AVR_SCHED_IDLE_STACK_SIZE - the size of the idle task stack, 128 bytes
+by default. The tick interrupt routine runs on this stack, too.
+
+AVR_SCHED_SLEEP_MODE - the sleep mode used by the idle task,
+SLEEP_MODE_IDLE by default. The tick timer MUST keep running in the
+chosen mode.
+
+AVR_SCHED_TICKLESS - when non-zero (the default), the idle task stops
+the periodic tick: the tick timer gets reprogrammed to fire only when
+the earliest delayed task should wake up (or when the timer period is
+over, which one comes first).
+*/
+#define AVR_SCHED_TICK_TIMER0 0
+#define AVR_SCHED_TICK_TIMER1 1
+#define AVR_SCHED_TICK_TIMER2 2
+#define AVR_SCHED_TICK_TCA0 3
+#define AVR_SCHED_TICK_TCB0 4
+
+#ifndef AVR_SCHED_TICK_SOURCE
+#if defined(TCB0)
+#define AVR_SCHED_TICK_SOURCE AVR_SCHED_TICK_TCB0
+#elif defined(TCCR2A)
+#define AVR_SCHED_TICK_SOURCE AVR_SCHED_TICK_TIMER2
+#else
+#define AVR_SCHED_TICK_SOURCE AVR_SCHED_TICK_TIMER1
+#endif
+#endif /* AVR_SCHED_TICK_SOURCE */
+
+#ifndef AVR_SCHED_TICK_HZ
+#define AVR_SCHED_TICK_HZ 1000
+#endif /* AVR_SCHED_TICK_HZ */
+
+#ifndef AVR_SCHED_IDLE_STACK_SIZE
+#define AVR_SCHED_IDLE_STACK_SIZE 128
+#endif /* AVR_SCHED_IDLE_STACK_SIZE */
+
+#ifndef AVR_SCHED_SLEEP_MODE
+#define AVR_SCHED_SLEEP_MODE SLEEP_MODE_IDLE
+#endif /* AVR_SCHED_SLEEP_MODE */
+
+#ifndef AVR_SCHED_TICKLESS
+#define AVR_SCHED_TICKLESS 1
+#endif /* AVR_SCHED_TICKLESS */
+
+/* The interrupt vector of the tick source. */
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+#define AVR_SCHED_TICK_VECTOR TIMER0_COMPA_vect
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+#define AVR_SCHED_TICK_VECTOR TIMER1_COMPA_vect
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+#define AVR_SCHED_TICK_VECTOR TIMER2_COMPA_vect
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+#define AVR_SCHED_TICK_VECTOR TCA0_OVF_vect
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+#define AVR_SCHED_TICK_VECTOR TCB0_INT_vect
+#else
+#error "Unknown AVR_SCHED_TICK_SOURCE value."
+#endif
+
+/* Task state codes */
+typedef enum avr_task_state_t_ {
+    AVR_TASK_READY = 0,
+    AVR_TASK_SUSPENDED,
+    AVR_TASK_DEAD,
+    AVR_TASK_DELAYED,
+    AVR_TASK_BLOCKED,
+    AVR_TASK_ILLEGAL,
+} avr_task_state_t;
+
+/* Task definition. The context MUST remain the first member: the
+ * context switching code uses a pointer to a task as a pointer to its
+ * context. */
+typedef struct avr_task_t_ {
+    avr_context_t ctx;
+    struct avr_task_t_ *next; /* ready (or delay) list links */
+    struct avr_task_t_ *prev;
+    uint32_t wake; /* the tick to wake up on, when delayed */
+    avr_context_func_t funcp;
+    void *funcargp;
+    uint8_t priority; /* the effective priority */
+    uint8_t base_priority; /* the priority assigned on initialisation */
+    char status;
+    struct avr_mutex_t_ *held; /* the mutexes owned by the task */
+    struct avr_mutex_t_ *blocker; /* the mutex the task waits for */
+    struct avr_task_t_ **waitq; /* the wait list the task is on */
+#if AVR_CONTEXT_STATS
+    avr_stats_t stats;
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_STACK_CANARY
+    void *stackp; /* the low end of the stack, if known */
+#endif /* AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_TRY
+    avr_try_t *try_chain; /* the protected regions, while not running */
+#endif /* AVR_CONTEXT_TRY */
+} avr_task_t;
+
+/* Mutex definition. The waiting tasks get linked through their own
+ * structures, sorted by priority. */
+typedef struct avr_mutex_t_ {
+    avr_task_t *owner;
+    avr_task_t *waiters;
+    struct avr_mutex_t_ *next; /* the next mutex owned by the same task */
+} avr_mutex_t;
+
+/* Counting semaphore definition. */
+typedef struct avr_sem_t_ {
+    avr_task_t *waiters;
+    uint16_t count;
+} avr_sem_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The context of the currently running task. It is used by the context
+switching code (see AVR_SAVE_CONTEXT_GLOBAL_POINTER and
+AVR_RESTORE_CONTEXT_GLOBAL_POINTER).
+*/
+extern avr_context_t *volatile avr_sched_current_ctx;
+
+/*
+The functions below implement a preemptive priority based task
+scheduler on top of the context switching facility.
+
+A task is represented by the "avr_task_t" data type. Every task has a
+priority in the range [0, AVR_SCHED_PRIORITIES - 1], the higher the
+number, the higher the priority. The scheduler always runs the ready
+task with the highest priority. The tasks of the same priority get
+switched in Round Robin fashion on every tick.
+
+The ready tasks of every priority are kept in intrusive circular lists
+(no memory gets allocated). A bitmap of non-empty ready lists makes it
+possible to choose the next task in constant time, regardless of the
+number of tasks.
+
+When there are no ready tasks, the scheduler activates the built-in
+idle task, which puts the MCU to sleep until an interrupt arrives (see
+AVR_SCHED_SLEEP_MODE above). If the tick source is running (see
+avr_sched_tick_start()) it also stops the periodic tick until the
+earliest delayed task should wake up (see AVR_SCHED_TICKLESS above).
+Any interrupt routine which makes a task ready wakes the idle task,
+which switches to that task.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with the following exceptions:
+avr_task_state() returns either a state of a task (represented as a
+member of the "avr_task_state_t" data type) or "AVR_TASK_ILLEGAL" on
+failure, avr_sched_current() returns the currently running task (or
+the idle task), avr_sched_tick_count() returns the number of ticks.
+
+The function avr_sched_init() initialises the scheduler and converts
+the currently running code into a task represented by a structure
+pointed at by "main_task" with the priority "priority". The context of
+the task gets saved during the first switch.
+
+The function avr_task_init() initialises a task represented by a
+structure pointed at by "task", and makes it ready. Upon activation,
+the function "funcp" gets called with the "funcargp" value passed as
+its argument. When this function returns, the task becomes dead. The
+caller must allocate a stack for the task (stackp, stack_size).
+
+When the stack overflow detection is enabled (see
+AVR_CONTEXT_STACK_CANARY in avrcontext.h), the guard word of the task
+stack gets checked every time the scheduler switches away from the
+task. The stack of the task created by avr_sched_init() does not get
+checked.
+
+The function avr_task_suspend() removes a task from the set of ready
+tasks. If the task is the currently running one, the next task gets
+activated immediately.
+
+The function avr_task_resume() makes a suspended task ready again. If
+its priority is higher than the one of the currently running task,
+the task gets activated immediately.
+
+These three functions should not be called from within interrupt
+routines. The functions avr_sched_ready() and avr_sched_unready() are
+their low-level counterparts to be used in such cases. They perform
+no checks, do not switch tasks, and MUST be called with interrupts
+disabled. The switch happens on the next tick.
+
+The function avr_sched_yield() passes control to the next ready task
+of the same priority, if there is one. It MUST NOT be called from
+within interrupt routines.
+
+The function avr_task_delay() removes the currently running task from
+the set of ready tasks for the "ticks" number of ticks (at least
+"ticks - 1" full tick periods), which should be less than 2^31. The
+task becomes delayed, and it gets ready again by the tick interrupt
+routine. Delaying for zero ticks is the same as avr_sched_yield().
+Delays work only with the built-in tick source (see
+avr_sched_tick_isr()). It MUST NOT be called from within interrupt
+routines.
+
+The function avr_sched_tick_count() returns the number of ticks since
+the tick source has been started. In tickless mode, the count may
+lag for less than a tick every time the idle task gets woken up
+before the timer fires.
+
+The function avr_task_stats() is available only when the accounting
+is enabled (see AVR_CONTEXT_STATS in avrcontext.h). It copies the
+statistics of the task into "snapshot" (see avr_stats_read()): the
+time the task has been running for (including the time spent in the
+interrupt routines), and the number of its activations. When "task"
+is "NULL", the statistics of the idle task get copied, which makes it
+possible to calculate the CPU load.
+
+The function avr_sched_tick() chooses the task to switch to on the
+tick of a system timer: it moves the currently running task to the end
+of its ready list and assigns the context of the chosen task to
+avr_sched_current_ctx. It is meant to be used between the context
+saving and restoring code of an interrupt routine (see
+AVR_SCHED_SWITCH_FROM_ISR below).
+*/
+extern int avr_sched_init(avr_task_t *main_task, uint8_t priority);
+extern int avr_task_init(avr_task_t *task,
+                         void *stackp, const size_t stack_size,
+                         uint8_t priority,
+                         avr_context_func_t funcp, void *funcargp);
+extern int avr_task_suspend(avr_task_t *task);
+extern int avr_task_resume(avr_task_t *task);
+extern avr_task_state_t avr_task_state(const avr_task_t *task);
+extern avr_task_t *avr_sched_current(void);
+extern void avr_sched_ready(avr_task_t *task);
+extern void avr_sched_unready(avr_task_t *task);
+extern void avr_sched_yield(void);
+extern int avr_task_delay(uint32_t ticks);
+extern uint32_t avr_sched_tick_count(void);
+#if AVR_CONTEXT_STATS
+extern int avr_task_stats(const avr_task_t *task, avr_stats_t *snapshot);
+#endif /* AVR_CONTEXT_STATS */
+extern void avr_sched_tick(void);
+
+/*
+The functions below implement the blocking synchronisation
+primitives for the tasks: mutexes and counting semaphores. A task
+which cannot proceed gets removed from the set of ready tasks (it
+becomes blocked), so it does not spend any CPU time until it gets
+woken up. The blocked tasks are kept in the wait lists of the
+primitives sorted by priority (in FIFO order within the same
+priority), and the one with the highest priority gets woken up first.
+The mutex or the semaphore unit gets handed over to the woken up task
+directly, so that no other task could take it in between.
+
+A mutex is represented by the "avr_mutex_t" data type, and a
+semaphore is represented by the "avr_sem_t" data type. Both of them
+should be treated as opaque data types.
+
+The mutexes implement priority inheritance: while a task of a higher
+priority waits for a mutex, the owner of the mutex runs with that
+priority, so that the tasks of the intermediate priorities could not
+preempt it (priority inversion). The inherited priority propagates
+along the chain of owners, if the owner itself waits for another
+mutex. When the owner unlocks the mutex, its priority returns to the
+highest of its own one and the ones inherited through the rest of the
+mutexes it owns. The function avr_task_priority() returns the
+effective priority of a task.
+
+All of the functions return 0 on success or 1 on failure. The
+functions avr_mutex_trylock() and avr_sem_trywait() fail if the mutex
+or the semaphore is not available. The function avr_task_priority()
+returns the priority of a task (or 0 if the "NULL" value was passed).
+
+The function avr_mutex_init() initialises a mutex represented by a
+structure pointed at by "mutex" in the unlocked state.
+
+The function avr_mutex_lock() locks the mutex, blocking the currently
+running task until the mutex becomes available. The mutexes are not
+recursive: the function fails if the task already owns the mutex.
+
+The function avr_mutex_unlock() unlocks the mutex owned by the
+currently running task. If there are tasks waiting for the mutex, the
+one with the highest priority becomes the owner, and it gets activated
+immediately if its priority is higher than the one of the currently
+running task. It fails if the task does not own the mutex. A task MUST
+unlock all of its mutexes before its function returns.
+
+The function avr_sem_init() initialises a semaphore represented by a
+structure pointed at by "sem" with the "count" number of units.
+
+The function avr_sem_wait() takes a unit of the semaphore, blocking
+the currently running task until one becomes available.
+
+The function avr_sem_post() returns a unit to the semaphore. If there
+are tasks waiting for the semaphore, the one with the highest priority
+takes the unit and becomes ready (and gets activated immediately if
+its priority is higher than the one of the currently running task).
+It fails if the count would overflow.
+
+These functions MUST NOT be called from within interrupt routines.
+The function avr_sem_post_isr() is the counterpart of avr_sem_post()
+to be used in such cases. It does not switch tasks, and it MUST be
+called with interrupts disabled. The switch happens on the next tick,
+unless the function gets called from within AVR_SCHED_SWITCH_FROM_ISR
+followed by avr_sched_tick():
+
+ISR(INT0_vect, ISR_NAKED)
+{
+    AVR_SCHED_SWITCH_FROM_ISR(avr_sem_post_isr(&button_sem); avr_sched_tick());
+}
+*/
+extern int avr_mutex_init(avr_mutex_t *mutex);
+extern int avr_mutex_lock(avr_mutex_t *mutex);
+extern int avr_mutex_trylock(avr_mutex_t *mutex);
+extern int avr_mutex_unlock(avr_mutex_t *mutex);
+extern int avr_sem_init(avr_sem_t *sem, uint16_t count);
+extern int avr_sem_wait(avr_sem_t *sem);
+extern int avr_sem_trywait(avr_sem_t *sem);
+extern int avr_sem_post(avr_sem_t *sem);
+extern int avr_sem_post_isr(avr_sem_t *sem);
+extern uint8_t avr_task_priority(const avr_task_t *task);
+
+/*
+The functions below manage the tick source chosen when compiling (see
+AVR_SCHED_TICK_SOURCE and AVR_SCHED_TICK_HZ above).
+
+The function avr_sched_tick_start() configures the timer to generate
+an interrupt AVR_SCHED_TICK_HZ times per second and starts it. The
+function avr_sched_tick_stop() stops the timer.
+
+The function avr_sched_tick_isr() is meant to be called on every tick
+from within the tick interrupt routine in place of avr_sched_tick():
+it acknowledges the interrupt (if the timer requires that), counts
+the tick, wakes up the delayed tasks, and chooses the next task. See
+AVR_SCHED_TICK_ISR below.
+*/
+extern void avr_sched_tick_start(void);
+extern void avr_sched_tick_stop(void);
+extern void avr_sched_tick_isr(void);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+/*
+AVR_SCHED_SWITCH_FROM_ISR macro expands to the body of a naked
+interrupt routine which saves the context of the current task,
+executes the code passed as 'code' argument, and restores the
+context of the task assigned to avr_sched_current_ctx.
+
+It is safe to call C functions from 'code'. The code gets executed
+on the stack of the interrupted task, so every task stack should have
+enough room for it.
+
+As the interrupted task has been running with interrupts enabled,
+the saved status register gets the interrupt flag set. This way the
+saved context could be restored either from an interrupt routine or
+by avr_sched_yield().
+
+Example:
+
+ISR(WDT_vect, ISR_NAKED)
+{
+    AVR_SCHED_SWITCH_FROM_ISR(avr_sched_tick());
+}
+*/
+#define AVR_SCHED_SWITCH_FROM_ISR(code)                                 \
+    do {                                                                \
+        AVR_SAVE_CONTEXT_GLOBAL_POINTER(                                \
+            "ori r30, 0x80\n", /* set the I flag in the saved SREG */   \
+            avr_sched_current_ctx);                                     \
+        /* compiled code expects R1 to be zero */                       \
+        __asm__ __volatile__("clr r1\n");                               \
+        code;                                                           \
+        AVR_RESTORE_CONTEXT_GLOBAL_POINTER(avr_sched_current_ctx);      \
+        __asm__ __volatile__("reti\n");                                 \
+    } while (0)
+
+/*
+AVR_SCHED_SWITCH_FROM_ISR_ON_REQUEST macro is the counterpart of
+AVR_SCHED_SWITCH_FROM_ISR for the interrupt routines which do their
+work in ordinary C code and rarely switch tasks. It expands to the body
+of a naked interrupt routine which calls 'handler', a function of type
+uint8_t (*)(void), saving only the registers a C function may clobber
+(see AVR_ISR_SWITCH_GLOBAL_POINTER). When the function returns
+non-zero, the context of the current task gets saved completely and
+avr_sched_tick() switches to the next task. Otherwise, the routine
+returns to the interrupted task right away.
+
+Example:
+
+static uint8_t button_isr(void)
+{
+    return avr_sem_post_isr(&button_sem) == 0;
+}
+
+ISR(INT0_vect, ISR_NAKED)
+{
+    AVR_SCHED_SWITCH_FROM_ISR_ON_REQUEST(button_isr);
+}
+*/
+#define AVR_SCHED_SWITCH_FROM_ISR_ON_REQUEST(handler)                   \
+    AVR_ISR_SWITCH_GLOBAL_POINTER(                                      \
+        handler,                                                        \
+        "ori r18, 0x80\n", /* set the I flag in the saved SREG */       \
+        avr_sched_tick(),                                               \
+        avr_sched_current_ctx)
+
+/*
+AVR_SCHED_TICK_ISR macro defines the interrupt routine of the tick
+source. It should be used once across the project, at the file scope,
+after including <avr/interrupt.h>:
+
+AVR_SCHED_TICK_ISR()
+*/
+#define AVR_SCHED_TICK_ISR()                                            \
+    ISR(AVR_SCHED_TICK_VECTOR, ISR_NAKED)                               \
+    {                                                                   \
+        AVR_SCHED_SWITCH_FROM_ISR(avr_sched_tick_isr());                \
+    }
+
+#endif /* __AVR__ */
+#endif /* AVRSCHED_H */
@@ -0,0 +1,1023 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the task scheduler functions.
+It meant to be included after 'avrsched.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRSCHED_IMPL_H
+#define AVRSCHED_IMPL_H
+
+#ifdef __AVR__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+avr_context_t *volatile avr_sched_current_ctx;
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+/* The heads of the ready lists, one per priority. */
+static avr_task_t *avr_sched_ready_list[AVR_SCHED_PRIORITIES];
+/* The bitmap of non-empty ready lists. */
+static uint8_t avr_sched_ready_map;
+
+#define AVR_SCHED_CURRENT_TASK() ((avr_task_t *)avr_sched_current_ctx)
+#define AVR_SCHED_ENTER_CRITICAL(sreg) \
+    do { (sreg) = SREG; __asm__ __volatile__("cli\n" ::: "memory"); } while (0)
+#define AVR_SCHED_EXIT_CRITICAL(sreg) \
+    do { SREG = (sreg); __asm__ __volatile__("" ::: "memory"); } while (0)
+
+/* The list of delayed tasks, sorted by the wake up tick. */
+static avr_task_t *avr_sched_delay_list;
+/* The number of ticks since the tick source has been started. */
+static volatile uint32_t avr_sched_ticks;
+/* Non-zero when the tick source is running. */
+static uint8_t avr_sched_tick_running;
+/* The length of the current tickless period (in ticks) or zero. */
+static uint32_t avr_sched_tickless_ticks;
+
+/* The idle task. */
+static avr_task_t avr_sched_idle_task;
+static uint8_t avr_sched_idle_stack[AVR_SCHED_IDLE_STACK_SIZE];
+
+/*
+Tick source. The prescaler and the compare (period) value get chosen
+at compile time, so that the timer ticks AVR_SCHED_TICK_HZ times per
+second.
+*/
+#ifndef F_CPU
+#error "F_CPU should be defined to use the task scheduler."
+#endif /* F_CPU */
+
+#define AVR_SCHED_TICK_CYCLES ((F_CPU) / (AVR_SCHED_TICK_HZ))
+
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0 || AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+/* Timer0 and Timer1 share the prescaler values. */
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+#define AVR_SCHED_TICK_MAX 256UL
+#else
+#define AVR_SCHED_TICK_MAX 65536UL
+#endif
+#if AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX
+#define AVR_SCHED_TICK_PRESCALER 1UL
+#define AVR_SCHED_TICK_CS 1
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 8
+#define AVR_SCHED_TICK_PRESCALER 8UL
+#define AVR_SCHED_TICK_CS 2
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 64
+#define AVR_SCHED_TICK_PRESCALER 64UL
+#define AVR_SCHED_TICK_CS 3
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 256
+#define AVR_SCHED_TICK_PRESCALER 256UL
+#define AVR_SCHED_TICK_CS 4
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 1024
+#define AVR_SCHED_TICK_PRESCALER 1024UL
+#define AVR_SCHED_TICK_CS 5
+#else
+#error "AVR_SCHED_TICK_HZ is too low for the chosen timer."
+#endif
+#define AVR_SCHED_IDLE_PRESCALER 1024UL
+#define AVR_SCHED_IDLE_CS 5
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+#define AVR_SCHED_TICK_MAX 256UL
+#if AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX
+#define AVR_SCHED_TICK_PRESCALER 1UL
+#define AVR_SCHED_TICK_CS 1
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 8
+#define AVR_SCHED_TICK_PRESCALER 8UL
+#define AVR_SCHED_TICK_CS 2
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 32
+#define AVR_SCHED_TICK_PRESCALER 32UL
+#define AVR_SCHED_TICK_CS 3
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 64
+#define AVR_SCHED_TICK_PRESCALER 64UL
+#define AVR_SCHED_TICK_CS 4
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 128
+#define AVR_SCHED_TICK_PRESCALER 128UL
+#define AVR_SCHED_TICK_CS 5
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 256
+#define AVR_SCHED_TICK_PRESCALER 256UL
+#define AVR_SCHED_TICK_CS 6
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 1024
+#define AVR_SCHED_TICK_PRESCALER 1024UL
+#define AVR_SCHED_TICK_CS 7
+#else
+#error "AVR_SCHED_TICK_HZ is too low for the chosen timer."
+#endif
+#define AVR_SCHED_IDLE_PRESCALER 1024UL
+#define AVR_SCHED_IDLE_CS 7
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+#define AVR_SCHED_TICK_MAX 65536UL
+#if AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX
+#define AVR_SCHED_TICK_PRESCALER 1UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV1_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 2
+#define AVR_SCHED_TICK_PRESCALER 2UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV2_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 4
+#define AVR_SCHED_TICK_PRESCALER 4UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV4_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 8
+#define AVR_SCHED_TICK_PRESCALER 8UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV8_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 16
+#define AVR_SCHED_TICK_PRESCALER 16UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV16_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 64
+#define AVR_SCHED_TICK_PRESCALER 64UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV64_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 256
+#define AVR_SCHED_TICK_PRESCALER 256UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV256_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 1024
+#define AVR_SCHED_TICK_PRESCALER 1024UL
+#define AVR_SCHED_TICK_CS TCA_SINGLE_CLKSEL_DIV1024_gc
+#else
+#error "AVR_SCHED_TICK_HZ is too low for the chosen timer."
+#endif
+#define AVR_SCHED_IDLE_PRESCALER 1024UL
+#define AVR_SCHED_IDLE_CS TCA_SINGLE_CLKSEL_DIV1024_gc
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+#define AVR_SCHED_TICK_MAX 65536UL
+#if AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX
+#define AVR_SCHED_TICK_PRESCALER 1UL
+#define AVR_SCHED_TICK_CS TCB_CLKSEL_CLKDIV1_gc
+#elif AVR_SCHED_TICK_CYCLES <= AVR_SCHED_TICK_MAX * 2
+#define AVR_SCHED_TICK_PRESCALER 2UL
+#define AVR_SCHED_TICK_CS TCB_CLKSEL_CLKDIV2_gc
+#else
+#error "AVR_SCHED_TICK_HZ is too low for TCB0, please consider using TCA0."
+#endif
+/* TCB0 has no prescaler of its own, so it cannot sleep for long. */
+#define AVR_SCHED_IDLE_PRESCALER 2UL
+#define AVR_SCHED_IDLE_CS TCB_CLKSEL_CLKDIV2_gc
+#endif /* AVR_SCHED_TICK_SOURCE */
+
+/* The compare (period) value. */
+#define AVR_SCHED_TICK_TOP (AVR_SCHED_TICK_CYCLES / AVR_SCHED_TICK_PRESCALER - 1)
+
+/* The longest tickless idle period (in ticks) the timer can measure. */
+#define AVR_SCHED_TICKLESS_MAX (AVR_SCHED_TICK_MAX * AVR_SCHED_IDLE_PRESCALER / AVR_SCHED_TICK_CYCLES)
+
+/* Restart the tick timer with the given clock selection and compare (period) value. */
+static void avr_sched_tick_program(uint8_t cs, uint16_t top)
+{
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+    TCCR0B = 0;
+    TCNT0 = 0;
+    OCR0A = (uint8_t)top;
+    TIFR0 = 1 << OCF0A;
+    TCCR0B = cs;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+    TCCR1B = 0;
+    TCNT1 = 0;
+    OCR1A = top;
+    TIFR1 = 1 << OCF1A;
+    TCCR1B = 1 << WGM12 | cs; /* CTC mode */
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+    TCCR2B = 0;
+    TCNT2 = 0;
+    OCR2A = (uint8_t)top;
+    TIFR2 = 1 << OCF2A;
+    TCCR2B = cs;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    TCA0.SINGLE.CTRLA = 0;
+    TCA0.SINGLE.CNT = 0;
+    TCA0.SINGLE.PER = top;
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+    TCA0.SINGLE.CTRLA = cs | TCA_SINGLE_ENABLE_bm;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    TCB0.CTRLA = 0;
+    TCB0.CNT = 0;
+    TCB0.CCMP = top;
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    TCB0.CTRLA = cs | TCB_ENABLE_bm;
+#endif /* AVR_SCHED_TICK_SOURCE */
+}
+
+/* Read the tick timer counter. */
+static uint16_t avr_sched_tick_counter(void)
+{
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+    return TCNT0;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+    return TCNT1;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+    return TCNT2;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    return TCA0.SINGLE.CNT;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    return TCB0.CNT;
+#endif /* AVR_SCHED_TICK_SOURCE */
+}
+
+/* Check if the tick interrupt is pending. */
+static uint8_t avr_sched_tick_pending(void)
+{
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+    return TIFR0 & (1 << OCF0A);
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+    return TIFR1 & (1 << OCF1A);
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+    return TIFR2 & (1 << OCF2A);
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    return TCA0.SINGLE.INTFLAGS & TCA_SINGLE_OVF_bm;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    return TCB0.INTFLAGS & TCB_CAPT_bm;
+#endif /* AVR_SCHED_TICK_SOURCE */
+}
+
+
+/* Find the most significant bit set in a non-zero bitmap in constant time. */
+static uint8_t avr_sched_highest_priority(uint8_t map)
+{
+    uint8_t prio = 0;
+    if (map & 0xF0)
+    {
+        prio += 4;
+        map >>= 4;
+    }
+    if (map & 0x0C)
+    {
+        prio += 2;
+        map >>= 2;
+    }
+    if (map & 0x02)
+    {
+        prio += 1;
+    }
+    return prio;
+}
+
+/* Make the delayed tasks which should wake up by now ready. */
+static void avr_sched_wake_expired(void)
+{
+    const uint32_t now = avr_sched_ticks;
+    avr_task_t *task;
+    while ((task = avr_sched_delay_list) != NULL &&
+           (int32_t)(now - task->wake) >= 0)
+    {
+        avr_sched_delay_list = task->next;
+        avr_sched_ready(task);
+    }
+}
+
+/* Stop the periodic tick until the earliest delayed task should wake up. */
+static void avr_sched_tickless_begin(void)
+{
+    uint32_t ticks = AVR_SCHED_TICKLESS_MAX;
+    if (avr_sched_delay_list != NULL &&
+        avr_sched_delay_list->wake - avr_sched_ticks < ticks)
+    {
+        ticks = avr_sched_delay_list->wake - avr_sched_ticks;
+    }
+    if (ticks <= 1)
+    {
+        return;
+    }
+    avr_sched_tickless_ticks = ticks;
+    avr_sched_tick_program(AVR_SCHED_IDLE_CS,
+                           (uint16_t)(ticks * AVR_SCHED_TICK_CYCLES / AVR_SCHED_IDLE_PRESCALER - 1));
+}
+
+/* Account for the ticks passed while tickless and restart the periodic tick. */
+static void avr_sched_tickless_end(uint8_t expired)
+{
+    if (expired)
+    {
+        avr_sched_ticks += avr_sched_tickless_ticks;
+    }
+    else
+    {
+        avr_sched_ticks += (uint32_t)avr_sched_tick_counter() * AVR_SCHED_IDLE_PRESCALER / AVR_SCHED_TICK_CYCLES;
+    }
+    avr_sched_tickless_ticks = 0;
+    avr_sched_tick_program(AVR_SCHED_TICK_CS, AVR_SCHED_TICK_TOP);
+    avr_sched_wake_expired();
+}
+
+/* Assign the context of the ready task with the highest priority (or
+ * the idle task) to avr_sched_current_ctx. */
+static void avr_sched_select(void)
+{
+    avr_task_t *next;
+    if (avr_sched_ready_map == 0)
+    {
+        next = &avr_sched_idle_task;
+    }
+    else
+    {
+        /* Leaving the idle task: restore the periodic tick, unless the
+         * tick interrupt is pending and is going to do that. */
+        if (avr_sched_tickless_ticks != 0 && !avr_sched_tick_pending())
+        {
+            avr_sched_tickless_end(0);
+        }
+        next = avr_sched_ready_list[avr_sched_highest_priority(avr_sched_ready_map)];
+    }
+#if AVR_CONTEXT_STACK_CANARY
+    if (AVR_SCHED_CURRENT_TASK()->stackp != NULL)
+    {
+        AVR_STACK_CHECK(AVR_SCHED_CURRENT_TASK()->stackp);
+    }
+#endif /* AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_STATS
+    if (next != AVR_SCHED_CURRENT_TASK())
+    {
+        avr_stats_switch(&AVR_SCHED_CURRENT_TASK()->stats, &next->stats);
+    }
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_TRY
+    AVR_SCHED_CURRENT_TASK()->try_chain = avr_try_top;
+    avr_try_top = next->try_chain;
+#endif /* AVR_CONTEXT_TRY */
+    avr_sched_current_ctx = &next->ctx;
+}
+
+void avr_sched_ready(avr_task_t *task)
+{
+    const uint8_t prio = task->priority;
+    avr_task_t *head = avr_sched_ready_list[prio];
+    task->status = (char)AVR_TASK_READY;
+    if (head == NULL)
+    {
+        task->next = task;
+        task->prev = task;
+        avr_sched_ready_list[prio] = task;
+        avr_sched_ready_map |= (uint8_t)(1 << prio);
+        return;
+    }
+    /* insert at the end of the list */
+    task->next = head;
+    task->prev = head->prev;
+    head->prev->next = task;
+    head->prev = task;
+}
+
+void avr_sched_unready(avr_task_t *task)
+{
+    const uint8_t prio = task->priority;
+    task->status = (char)AVR_TASK_SUSPENDED;
+    if (task->next == task)
+    {
+        avr_sched_ready_list[prio] = NULL;
+        avr_sched_ready_map &= (uint8_t)~(1 << prio);
+        return;
+    }
+    task->prev->next = task->next;
+    task->next->prev = task->prev;
+    if (avr_sched_ready_list[prio] == task)
+    {
+        avr_sched_ready_list[prio] = task->next;
+    }
+}
+
+void avr_sched_tick(void)
+{
+    avr_task_t *current = AVR_SCHED_CURRENT_TASK();
+    /* Round Robin: move the current task to the end of its list. */
+    if (current->status == (char)AVR_TASK_READY &&
+        avr_sched_ready_list[current->priority] == current)
+    {
+        avr_sched_ready_list[current->priority] = current->next;
+    }
+    avr_sched_select();
+}
+
+/*
+Switch from the currently running task to the one chosen by 'code'.
+This code expects to be placed into a naked function: the return
+address should be on top of the stack.
+*/
+#define AVR_SCHED_SWITCH_FROM_TASK(code)                                \
+    do {                                                                \
+        AVR_SAVE_CONTEXT_GLOBAL_POINTER(                                \
+            "cli\n", /* disable interrupts during task switching */     \
+            avr_sched_current_ctx);                                     \
+        code;                                                           \
+        AVR_RESTORE_CONTEXT_GLOBAL_POINTER(avr_sched_current_ctx);      \
+        __asm__ __volatile__("ret\n");                                  \
+    } while (0)
+
+void avr_sched_yield(void) __attribute__ ((naked));
+void avr_sched_yield(void)
+{
+    AVR_SCHED_SWITCH_FROM_TASK(avr_sched_tick());
+}
+
+static void avr_sched_reschedule(void) __attribute__ ((naked, noinline));
+static void avr_sched_reschedule(void)
+{
+    AVR_SCHED_SWITCH_FROM_TASK(avr_sched_select());
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+static void avr_sched_task_entry(void *arg);
+static void avr_sched_idle(void *arg);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+static void avr_sched_task_entry(void *arg)
+{
+    uint8_t sreg;
+    avr_task_t *task = (avr_task_t *)arg;
+    task->funcp(task->funcargp);
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    (void)sreg;
+    avr_sched_unready(task);
+    task->status = (char)AVR_TASK_DEAD;
+    avr_sched_reschedule();
+    /* unreachable */
+}
+
+static void avr_sched_idle(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        __asm__ __volatile__("cli\n" ::: "memory");
+        if (avr_sched_ready_map != 0)
+        {
+            avr_sched_reschedule();
+            continue;
+        }
+#if AVR_SCHED_TICKLESS
+        if (avr_sched_tick_running && avr_sched_tickless_ticks == 0)
+        {
+            avr_sched_tickless_begin();
+        }
+#endif /* AVR_SCHED_TICKLESS */
+        set_sleep_mode(AVR_SCHED_SLEEP_MODE);
+        sleep_enable();
+        /* The instruction after "sei" gets executed before any pending
+         * interrupt, so there is no wake up to miss. */
+        __asm__ __volatile__("sei\n"
+                             "sleep\n" ::: "memory");
+        sleep_disable();
+    }
+}
+
+int avr_sched_init(avr_task_t *main_task, uint8_t priority)
+{
+    uint8_t sreg;
+    if (main_task == NULL || priority >= AVR_SCHED_PRIORITIES)
+    {
+        return 1;
+    }
+    main_task->priority = priority;
+    main_task->base_priority = priority;
+    main_task->held = NULL;
+    main_task->blocker = NULL;
+    main_task->waitq = NULL;
+    main_task->funcp = NULL;
+    main_task->funcargp = NULL;
+#if AVR_CONTEXT_STACK_CANARY
+    main_task->stackp = NULL; /* unknown */
+    avr_sched_idle_task.stackp = avr_sched_idle_stack;
+#endif /* AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_TRY
+    main_task->try_chain = NULL;
+    avr_sched_idle_task.try_chain = NULL;
+#endif /* AVR_CONTEXT_TRY */
+    /* The idle task does not belong to any ready list. */
+    avr_sched_idle_task.priority = 0;
+    avr_sched_idle_task.base_priority = 0;
+    avr_sched_idle_task.held = NULL;
+    avr_sched_idle_task.funcp = avr_sched_idle;
+    avr_sched_idle_task.funcargp = NULL;
+    avr_sched_idle_task.status = (char)AVR_TASK_READY;
+    avr_initcontext(&avr_sched_idle_task.ctx,
+                    avr_sched_idle_stack, sizeof(avr_sched_idle_stack),
+                    NULL,
+                    avr_sched_idle, NULL, 0);
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    avr_sched_ready(main_task);
+    /* the context gets saved during the first switch */
+    avr_sched_current_ctx = &main_task->ctx;
+#if AVR_CONTEXT_STATS
+    main_task->stats.cycles = 0;
+    main_task->stats.switches = 0;
+    avr_sched_idle_task.stats.cycles = 0;
+    avr_sched_idle_task.stats.switches = 0;
+    avr_stats_switch(NULL, &main_task->stats);
+#endif /* AVR_CONTEXT_STATS */
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_task_init(avr_task_t *task,
+                  void *stackp, const size_t stack_size,
+                  uint8_t priority,
+                  avr_context_func_t funcp, void *funcargp)
+{
+    uint8_t sreg;
+    if (task == NULL || stackp == NULL || stack_size == 0 ||
+        priority >= AVR_SCHED_PRIORITIES || funcp == NULL)
+    {
+        return 1;
+    }
+    task->priority = priority;
+    task->base_priority = priority;
+    task->held = NULL;
+    task->blocker = NULL;
+    task->waitq = NULL;
+    task->funcp = funcp;
+    task->funcargp = funcargp;
+#if AVR_CONTEXT_STACK_CANARY
+    task->stackp = stackp;
+#endif /* AVR_CONTEXT_STACK_CANARY */
+#if AVR_CONTEXT_STATS
+    task->stats.cycles = 0;
+    task->stats.switches = 0;
+#endif /* AVR_CONTEXT_STATS */
+#if AVR_CONTEXT_TRY
+    task->try_chain = NULL;
+#endif /* AVR_CONTEXT_TRY */
+    /* The task never activates the successor context, see
+     * avr_sched_task_entry(). The tasks start with interrupts enabled. */
+    avr_initcontext(&task->ctx,
+                    stackp, stack_size,
+                    NULL,
+                    avr_sched_task_entry, task, 1);
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    avr_sched_ready(task);
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_task_suspend(avr_task_t *task)
+{
+    uint8_t sreg;
+    if (task == NULL || task->status != (char)AVR_TASK_READY)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    avr_sched_unready(task);
+    if (task == AVR_SCHED_CURRENT_TASK())
+    {
+        avr_sched_reschedule();
+    }
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_task_resume(avr_task_t *task)
+{
+    uint8_t sreg;
+    if (task == NULL || task->status != (char)AVR_TASK_SUSPENDED)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    avr_sched_ready(task);
+    if (task->priority > AVR_SCHED_CURRENT_TASK()->priority)
+    {
+        avr_sched_reschedule();
+    }
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_task_delay(uint32_t ticks)
+{
+    uint8_t sreg;
+    avr_task_t *task, **pos;
+    if (ticks >= 0x80000000UL)
+    {
+        return 1;
+    }
+    if (ticks == 0)
+    {
+        avr_sched_yield();
+        return 0;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    task = AVR_SCHED_CURRENT_TASK();
+    avr_sched_unready(task);
+    task->status = (char)AVR_TASK_DELAYED;
+    task->wake = avr_sched_ticks + ticks;
+    /* keep the list sorted, the tasks with the same wake up tick go in FIFO order */
+    pos = &avr_sched_delay_list;
+    while (*pos != NULL && (int32_t)((*pos)->wake - task->wake) <= 0)
+    {
+        pos = &(*pos)->next;
+    }
+    task->next = *pos;
+    *pos = task;
+    avr_sched_reschedule();
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+/* Insert a task into a wait list, keeping it sorted by priority. The
+ * tasks of the same priority go in FIFO order. */
+static void avr_sched_wait_insert(avr_task_t **list, avr_task_t *task)
+{
+    avr_task_t **pos = list;
+    while (*pos != NULL && (*pos)->priority >= task->priority)
+    {
+        pos = &(*pos)->next;
+    }
+    task->next = *pos;
+    *pos = task;
+    task->waitq = list;
+}
+
+static void avr_sched_wait_remove(avr_task_t *task)
+{
+    avr_task_t **pos = task->waitq;
+    while (*pos != task)
+    {
+        pos = &(*pos)->next;
+    }
+    *pos = task->next;
+    task->waitq = NULL;
+}
+
+/* Block the currently running task on a wait list and switch to the next one. */
+static void avr_sched_block(avr_task_t **list, avr_mutex_t *blocker)
+{
+    avr_task_t *task = AVR_SCHED_CURRENT_TASK();
+    avr_sched_unready(task);
+    task->status = (char)AVR_TASK_BLOCKED;
+    task->blocker = blocker;
+    avr_sched_wait_insert(list, task);
+}
+
+/* Make the task with the highest priority on a wait list ready. */
+static avr_task_t *avr_sched_wake_first(avr_task_t **list)
+{
+    avr_task_t *task = *list;
+    *list = task->next;
+    task->waitq = NULL;
+    task->blocker = NULL;
+    avr_sched_ready(task);
+    return task;
+}
+
+/* Change the effective priority of a task, keeping it in the right place. */
+static void avr_sched_set_priority(avr_task_t *task, uint8_t priority)
+{
+    if (task->priority == priority)
+    {
+        return;
+    }
+    if (task->status == (char)AVR_TASK_READY)
+    {
+        avr_sched_unready(task);
+        task->priority = priority;
+        avr_sched_ready(task);
+    }
+    else if (task->status == (char)AVR_TASK_BLOCKED)
+    {
+        avr_task_t **list = task->waitq;
+        avr_sched_wait_remove(task);
+        task->priority = priority;
+        avr_sched_wait_insert(list, task);
+    }
+    else
+    {
+        task->priority = priority;
+    }
+}
+
+/* The highest of the own priority of a task and the ones of the tasks
+ * waiting for its mutexes. */
+static uint8_t avr_sched_inherited_priority(const avr_task_t *task)
+{
+    uint8_t priority = task->base_priority;
+    const avr_mutex_t *mutex;
+    for (mutex = task->held; mutex != NULL; mutex = mutex->next)
+    {
+        if (mutex->waiters != NULL && mutex->waiters->priority > priority)
+        {
+            priority = mutex->waiters->priority;
+        }
+    }
+    return priority;
+}
+
+/* Switch if there is a ready task with a higher priority than the
+ * currently running one. */
+static void avr_sched_preempt(void)
+{
+    if (avr_sched_ready_map >> AVR_SCHED_CURRENT_TASK()->priority > 1)
+    {
+        avr_sched_reschedule();
+    }
+}
+
+int avr_mutex_init(avr_mutex_t *mutex)
+{
+    if (mutex == NULL)
+    {
+        return 1;
+    }
+    mutex->owner = NULL;
+    mutex->waiters = NULL;
+    mutex->next = NULL;
+    return 0;
+}
+
+int avr_mutex_lock(avr_mutex_t *mutex)
+{
+    uint8_t sreg;
+    avr_task_t *task, *owner;
+    if (mutex == NULL)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    task = AVR_SCHED_CURRENT_TASK();
+    owner = mutex->owner;
+    if (owner == NULL)
+    {
+        mutex->owner = task;
+        mutex->next = task->held;
+        task->held = mutex;
+        AVR_SCHED_EXIT_CRITICAL(sreg);
+        return 0;
+    }
+    if (owner == task)
+    {
+        AVR_SCHED_EXIT_CRITICAL(sreg);
+        return 1;
+    }
+    avr_sched_block(&mutex->waiters, mutex);
+    /* Priority inheritance along the chain of owners. */
+    while (owner != NULL && owner->priority < task->priority)
+    {
+        avr_sched_set_priority(owner, task->priority);
+        if (owner->status != (char)AVR_TASK_BLOCKED || owner->blocker == NULL)
+        {
+            break;
+        }
+        owner = owner->blocker->owner;
+    }
+    avr_sched_reschedule();
+    /* The mutex has been handed over by avr_mutex_unlock(). */
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_mutex_trylock(avr_mutex_t *mutex)
+{
+    uint8_t sreg;
+    avr_task_t *task;
+    if (mutex == NULL)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    if (mutex->owner != NULL)
+    {
+        AVR_SCHED_EXIT_CRITICAL(sreg);
+        return 1;
+    }
+    task = AVR_SCHED_CURRENT_TASK();
+    mutex->owner = task;
+    mutex->next = task->held;
+    task->held = mutex;
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_mutex_unlock(avr_mutex_t *mutex)
+{
+    uint8_t sreg;
+    avr_task_t *task, *waiter;
+    avr_mutex_t **pos;
+    if (mutex == NULL)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    task = AVR_SCHED_CURRENT_TASK();
+    if (mutex->owner != task)
+    {
+        AVR_SCHED_EXIT_CRITICAL(sreg);
+        return 1;
+    }
+    for (pos = &task->held; *pos != mutex; pos = &(*pos)->next)
+        ;
+    *pos = mutex->next;
+    mutex->owner = NULL;
+    if (mutex->waiters != NULL)
+    {
+        /* hand the mutex over */
+        waiter = avr_sched_wake_first(&mutex->waiters);
+        mutex->owner = waiter;
+        mutex->next = waiter->held;
+        waiter->held = mutex;
+        avr_sched_set_priority(waiter, avr_sched_inherited_priority(waiter));
+    }
+    avr_sched_set_priority(task, avr_sched_inherited_priority(task));
+    avr_sched_preempt();
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_sem_init(avr_sem_t *sem, uint16_t count)
+{
+    if (sem == NULL)
+    {
+        return 1;
+    }
+    sem->waiters = NULL;
+    sem->count = count;
+    return 0;
+}
+
+int avr_sem_wait(avr_sem_t *sem)
+{
+    uint8_t sreg;
+    if (sem == NULL)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    if (sem->count != 0)
+    {
+        sem->count--;
+        AVR_SCHED_EXIT_CRITICAL(sreg);
+        return 0;
+    }
+    avr_sched_block(&sem->waiters, NULL);
+    avr_sched_reschedule();
+    /* The unit has been handed over by avr_sem_post(). */
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return 0;
+}
+
+int avr_sem_trywait(avr_sem_t *sem)
+{
+    uint8_t sreg;
+    int ret = 1;
+    if (sem == NULL)
+    {
+        return 1;
+    }
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    if (sem->count != 0)
+    {
+        sem->count--;
+        ret = 0;
+    }
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return ret;
+}
+
+int avr_sem_post(avr_sem_t *sem)
+{
+    uint8_t sreg;
+    int ret;
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    ret = avr_sem_post_isr(sem);
+    avr_sched_preempt();
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return ret;
+}
+
+int avr_sem_post_isr(avr_sem_t *sem)
+{
+    if (sem == NULL)
+    {
+        return 1;
+    }
+    if (sem->waiters != NULL)
+    {
+        avr_sched_wake_first(&sem->waiters);
+        return 0;
+    }
+    if (sem->count == 0xFFFF)
+    {
+        return 1;
+    }
+    sem->count++;
+    return 0;
+}
+
+uint8_t avr_task_priority(const avr_task_t *task)
+{
+    return task == NULL ? 0 : task->priority;
+}
+
+uint32_t avr_sched_tick_count(void)
+{
+    uint8_t sreg;
+    uint32_t ticks;
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+    ticks = avr_sched_ticks;
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+    return ticks;
+}
+
+avr_task_state_t avr_task_state(const avr_task_t *task)
+{
+    return task == NULL || task->status < AVR_TASK_READY || task->status >= AVR_TASK_ILLEGAL ? AVR_TASK_ILLEGAL : (avr_task_state_t)task->status;
+}
+
+avr_task_t *avr_sched_current(void)
+{
+    return AVR_SCHED_CURRENT_TASK();
+}
+
+#if AVR_CONTEXT_STATS
+int avr_task_stats(const avr_task_t *task, avr_stats_t *snapshot)
+{
+    return avr_stats_read(task == NULL ? &avr_sched_idle_task.stats : &task->stats, snapshot);
+}
+#endif /* AVR_CONTEXT_STATS */
+
+void avr_sched_tick_start(void)
+{
+    uint8_t sreg;
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+    TCCR0B = 0;
+    TCCR0A = 1 << WGM01; /* CTC mode */
+    TIMSK0 |= 1 << OCIE0A;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+    TCCR1B = 0;
+    TCCR1A = 0;
+    TIMSK1 |= 1 << OCIE1A;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+    TCCR2B = 0;
+    TCCR2A = 1 << WGM21; /* CTC mode */
+    TIMSK2 |= 1 << OCIE2A;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    TCA0.SINGLE.CTRLA = 0;
+    TCA0.SINGLE.CTRLESET = TCA_SINGLE_CMD_RESET_gc;
+    TCA0.SINGLE.CTRLD = 0; /* disable the split mode */
+    TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_NORMAL_gc;
+    TCA0.SINGLE.INTCTRL = TCA_SINGLE_OVF_bm;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    TCB0.CTRLA = 0;
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc; /* periodic interrupt mode */
+    TCB0.INTCTRL = TCB_CAPT_bm;
+#endif /* AVR_SCHED_TICK_SOURCE */
+    avr_sched_tick_program(AVR_SCHED_TICK_CS, AVR_SCHED_TICK_TOP);
+    avr_sched_tickless_ticks = 0;
+    avr_sched_tick_running = 1;
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+}
+
+void avr_sched_tick_stop(void)
+{
+    uint8_t sreg;
+    AVR_SCHED_ENTER_CRITICAL(sreg);
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER0
+    TIMSK0 &= ~(1 << OCIE0A);
+    TCCR0B = 0;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER1
+    TIMSK1 &= ~(1 << OCIE1A);
+    TCCR1B = 0;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TIMER2
+    TIMSK2 &= ~(1 << OCIE2A);
+    TCCR2B = 0;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    TCA0.SINGLE.INTCTRL = 0;
+    TCA0.SINGLE.CTRLA = 0;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    TCB0.INTCTRL = 0;
+    TCB0.CTRLA = 0;
+#endif /* AVR_SCHED_TICK_SOURCE */
+    avr_sched_tickless_ticks = 0;
+    avr_sched_tick_running = 0;
+    AVR_SCHED_EXIT_CRITICAL(sreg);
+}
+
+void avr_sched_tick_isr(void)
+{
+    /* The megaAVR timers do not clear the interrupt flags by themselves. */
+#if AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCA0
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+#elif AVR_SCHED_TICK_SOURCE == AVR_SCHED_TICK_TCB0
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+#endif /* AVR_SCHED_TICK_SOURCE */
+    if (avr_sched_tickless_ticks != 0)
+    {
+        avr_sched_tickless_end(1);
+    }
+    else
+    {
+        avr_sched_ticks++;
+        avr_sched_wake_expired();
+    }
+    avr_sched_tick();
+}
+
+#endif /* __AVR__ */
+#endif /* AVRSCHED_IMPL_H */
@@ -0,0 +1,104 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRSHARED_H
+#define AVRSHARED_H
+
+#ifdef __AVR__
+
+struct avr_shared_coro_t_;
+
+/* Shared execution stack definition. */
+typedef struct avr_shared_stack_t_ {
+    uint8_t *stackp;
+    size_t stack_size;
+    struct avr_shared_coro_t_ *owner; /* whose frames are on the stack */
+} avr_shared_stack_t;
+
+/* Shared stack coroutine definition. The coroutine MUST remain the
+ * first member: the coroutine function receives a pointer to it as
+ * "self". */
+typedef struct avr_shared_coro_t_ {
+    avr_coro_t coro;
+    avr_shared_stack_t *stack;
+    uint8_t *savep; /* the save area */
+    size_t save_size;
+    size_t saved; /* the number of bytes in the save area */
+    size_t peak; /* the largest number of bytes saved so far */
+} avr_shared_coro_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement the shared stack (stack copying)
+coroutines on top of the coroutines facility. Any number of such
+coroutines run on a single execution stack. When a coroutine which
+does not own the stack gets resumed, the live part of the stack of
+the owner (from its saved stack pointer up to the top of the stack)
+gets copied out to the save area of the owner, and the saved part of
+the resumed coroutine gets copied back in. Thus, a coroutine needs a
+dedicated save area only as large as its stack depth at the points it
+yields from, while the execution stack should be large enough for the
+deepest coroutine. The copying happens only when the owner changes:
+resuming the same coroutine again costs nothing extra.
+
+A shared stack is represented by the "avr_shared_stack_t" data type,
+and a shared stack coroutine is represented by the
+"avr_shared_coro_t" data type. Both of them should be treated as
+opaque data types. The memory for the execution stack and the save
+areas gets provided by the caller, no memory gets allocated.
+
+The coroutine function receives a pointer to the "coro" member as
+"self", so it yields by avr_coro_yield() (or by any function built on
+top of it, e.g. avr_chan_send()) as usual, and avr_coro_state() works
+as usual, too. However, a shared stack coroutine MUST be resumed only
+by avr_shared_coro_resume(), and it MUST NOT transfer control by
+avr_coro_transfer(). Pointers to the variables on the stack of a
+coroutine MUST NOT be passed to other coroutines which share the
+stack, as the variables get moved out when the coroutine loses the
+stack. The stack MUST NOT be shared with the invoker.
+
+All of the functions return 0 on success or 1 on failure (usually
+because of a wrong argument), with one exception:
+avr_shared_coro_peak() returns the largest number of bytes copied out
+to the save area of the coroutine so far (or 0 on failure).
+
+The function avr_shared_stack_init() initialises a shared stack
+represented by a structure pointed at by "stack", with the memory
+region (stackp, stack_size) used as the execution stack.
+
+The function avr_shared_coro_init() initialises a coroutine
+represented by a structure pointed at by "coro", which runs on the
+shared stack "stack", with the memory region (savep, save_size) used
+as its save area. Otherwise, it behaves like avr_coro_init(). If the
+stack is owned by another coroutine, the owner gets copied out first
+(so the function fails if its save area is too small). The function
+fails if the owner of the stack is running, i.e. when it gets called
+from within a coroutine which runs on the stack.
+
+The function avr_shared_coro_resume() resumes a coroutine, copying the
+stacks as described above. Otherwise, it behaves like
+avr_coro_resume(). The function fails if the save area of the owner
+of the stack is too small to hold its live part, or if the owner is
+running, i.e. when it gets called from within a coroutine which runs
+on the stack. In these cases, no switch happens.
+*/
+extern int avr_shared_stack_init(avr_shared_stack_t *stack,
+                                 void *stackp, const size_t stack_size);
+extern int avr_shared_coro_init(avr_shared_coro_t *coro,
+                                avr_shared_stack_t *stack,
+                                void *savep, const size_t save_size,
+                                avr_coro_func_t func);
+extern int avr_shared_coro_resume(avr_shared_coro_t *coro, void **data);
+extern size_t avr_shared_coro_peak(const avr_shared_coro_t *coro);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+#endif /* __AVR__ */
+#endif /* AVRSHARED_H */
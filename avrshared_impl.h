@@ -0,0 +1,132 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRSHARED_IMPL_H
+#define AVRSHARED_IMPL_H
+
+#ifdef __AVR__
+
+/* Copy the live part of the stack of its owner (if any) out to the
+ * save area of the owner. A running owner has no saved stack pointer
+ * and is still using the stack, so it cannot be evicted. */
+static int avr_shared_stack_evict(avr_shared_stack_t *stack)
+{
+    avr_shared_coro_t *owner = stack->owner;
+    const uint8_t *top = stack->stackp + stack->stack_size - 1;
+    const uint8_t *sp;
+    size_t n, i;
+    if (owner == NULL)
+    {
+        return 0;
+    }
+    if (owner->coro.status == (char)AVR_CORO_RUNNING)
+    {
+        return 1;
+    }
+    if (owner->coro.status == (char)AVR_CORO_DEAD)
+    {
+        owner->saved = 0;
+        stack->owner = NULL;
+        return 0;
+    }
+    /* The stack pointer points to the next free byte. */
+    sp = (const uint8_t *)owner->coro.exec.sp.ptr;
+    n = (size_t)(top - sp);
+    if (n > owner->save_size)
+    {
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        owner->savep[i] = sp[1 + i];
+    }
+    owner->saved = n;
+    if (n > owner->peak)
+    {
+        owner->peak = n;
+    }
+    stack->owner = NULL;
+    return 0;
+}
+
+int avr_shared_stack_init(avr_shared_stack_t *stack,
+                          void *stackp, const size_t stack_size)
+{
+    if (stack == NULL || stackp == NULL || stack_size == 0)
+    {
+        return 1;
+    }
+    stack->stackp = (uint8_t *)stackp;
+    stack->stack_size = stack_size;
+    stack->owner = NULL;
+    return 0;
+}
+
+int avr_shared_coro_init(avr_shared_coro_t *coro,
+                         avr_shared_stack_t *stack,
+                         void *savep, const size_t save_size,
+                         avr_coro_func_t funcp)
+{
+    if (coro == NULL || stack == NULL || (savep == NULL && save_size != 0) || funcp == NULL)
+    {
+        return 1;
+    }
+    /* Preparing the context may touch the stack (e.g. to paint it). */
+    if (stack->owner == coro)
+    {
+        if (coro->coro.status == (char)AVR_CORO_RUNNING)
+        {
+            return 1;
+        }
+        stack->owner = NULL;
+    }
+    if (avr_shared_stack_evict(stack) != 0)
+    {
+        return 1;
+    }
+    coro->stack = stack;
+    coro->savep = (uint8_t *)savep;
+    coro->save_size = save_size;
+    coro->saved = 0;
+    coro->peak = 0;
+    return avr_coro_init(&coro->coro, stack->stackp, stack->stack_size, funcp);
+}
+
+int avr_shared_coro_resume(avr_shared_coro_t *coro, void **data)
+{
+    avr_shared_stack_t *stack;
+    if (coro == NULL || coro->coro.status != (char)AVR_CORO_SUSPENDED)
+    {
+        return 1;
+    }
+    stack = coro->stack;
+    if (stack->owner != coro)
+    {
+        uint8_t *dst;
+        size_t i;
+        if (avr_shared_stack_evict(stack) != 0)
+        {
+            return 1;
+        }
+        /* Put the saved part back right above the saved stack pointer. */
+        dst = stack->stackp + stack->stack_size - coro->saved;
+        for (i = 0; i < coro->saved; i++)
+        {
+            dst[i] = coro->savep[i];
+        }
+        stack->owner = coro;
+    }
+    return avr_coro_resume(&coro->coro, data);
+}
+
+size_t avr_shared_coro_peak(const avr_shared_coro_t *coro)
+{
+    return coro == NULL ? 0 : coro->peak;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRSHARED_IMPL_H */
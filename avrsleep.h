@@ -0,0 +1,60 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+#ifndef AVRSLEEP_H
+#define AVRSLEEP_H
+
+#ifdef __AVR__
+
+/* Sleeper definition. A sleeper resides on the stack of a sleeping
+ * coroutine, so no memory gets allocated. */
+typedef struct avr_sleeper_t_ {
+    struct avr_sleeper_t_ *next;
+    avr_coro_t *coro;
+    uint16_t delta; /* ticks after the previous sleeper */
+    volatile uint8_t expired;
+} avr_sleeper_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus */
+/*
+The functions below implement timed suspension of coroutines.
+
+The sleeping coroutines are kept in a delta queue: every entry holds
+the number of ticks after the expiration of the previous one. Thus, on
+every tick only the head of the queue gets inspected (and
+decremented), regardless of the number of sleeping coroutines. The
+entries get allocated on the stacks of the sleeping coroutines.
+
+The function avr_coro_sleep_ticks() suspends the currently running
+coroutine "self" for the "ticks" number of ticks (at least "ticks - 1"
+full tick periods). It returns 0 when the coroutine has been woken
+up, or 1 on failure. Sleeping for zero ticks returns immediately. If
+the invoker resumes the coroutine before the time is over, it yields
+again (passing the "NULL" value as data).
+
+The function avr_coro_sleep_tick() is meant to be called from within
+a periodic timer interrupt routine. It expires the sleepers which
+should wake up on this tick. It does not switch contexts.
+
+The function avr_coro_sleep_dispatch() resumes the coroutines which
+sleep has expired. It is meant to be called by the invoker of the
+coroutines, e.g. in the main loop. It returns the number of the
+coroutines resumed. The coroutines get resumed in the order their
+sleep has expired, and the ones which have expired on the same tick
+get resumed in the order they have fallen asleep.
+*/
+extern int avr_coro_sleep_ticks(avr_coro_t *self, uint16_t ticks);
+extern void avr_coro_sleep_tick(void);
+extern uint8_t avr_coro_sleep_dispatch(void);
+#ifdef __cplusplus
+}
+#endif /*__cplusplus */
+
+#endif /* __AVR__ */
+#endif /* AVRSLEEP_H */
@@ -0,0 +1,135 @@
+/*
+  Author: Artem Boldariev <artem@boldariev.com>
+  The software distributed under the terms of the MIT/Expat license.
+
+  See LICENSE.txt for license details.
+*/
+
+/*
+This file contains definitions of the coroutine sleep functions.
+It meant to be included after 'avrsleep.h'.
+In general, you should include it only once across the project.
+*/
+
+#ifndef AVRSLEEP_IMPL_H
+#define AVRSLEEP_IMPL_H
+
+#ifdef __AVR__
+
+/* The delta queue of sleeping coroutines. */
+static avr_sleeper_t *volatile avr_sleep_queue;
+/* The list of expired sleepers to be resumed, in the order of
+ * expiration, and the link to append to. */
+static avr_sleeper_t *volatile avr_sleep_expired;
+static avr_sleeper_t *volatile *volatile avr_sleep_expired_tail = &avr_sleep_expired;
+
+int avr_coro_sleep_ticks(avr_coro_t *self, uint16_t ticks)
+{
+    avr_sleeper_t sleeper, *volatile *pos;
+    uint8_t sreg;
+    if (self == NULL)
+    {
+        return 1;
+    }
+    if (ticks == 0)
+    {
+        return 0;
+    }
+    sleeper.coro = self;
+    sleeper.expired = 0;
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    /* find the place, making the delta relative to the previous entry */
+    pos = &avr_sleep_queue;
+    while (*pos != NULL && (*pos)->delta <= ticks)
+    {
+        ticks -= (*pos)->delta;
+        pos = &(*pos)->next;
+    }
+    sleeper.delta = ticks;
+    sleeper.next = *pos;
+    if (sleeper.next != NULL)
+    {
+        sleeper.next->delta -= ticks;
+    }
+    *pos = &sleeper;
+    SREG = sreg;
+    while (!sleeper.expired)
+    {
+        avr_coro_yield(self, NULL);
+    }
+    /* The invoker might have resumed the coroutine before
+     * avr_coro_sleep_dispatch() did: the sleeper MUST NOT remain in
+     * the list after leaving this frame. */
+    sreg = SREG;
+    __asm__ __volatile__("cli\n" ::: "memory");
+    for (pos = &avr_sleep_expired; *pos != NULL; pos = &(*pos)->next)
+    {
+        if (*pos == &sleeper)
+        {
+            *pos = sleeper.next;
+            if (sleeper.next == NULL)
+            {
+                avr_sleep_expired_tail = pos;
+            }
+            break;
+        }
+    }
+    SREG = sreg;
+    return 0;
+}
+
+void avr_coro_sleep_tick(void)
+{
+    avr_sleeper_t *head = avr_sleep_queue, *last;
+    if (head == NULL || --head->delta != 0)
+    {
+        return;
+    }
+    /* The sleepers with zero delta expire together with the previous
+     * one: move the whole run to the end of the expired list, keeping
+     * its order. */
+    last = head;
+    last->expired = 1;
+    while (last->next != NULL && last->next->delta == 0)
+    {
+        last = last->next;
+        last->expired = 1;
+    }
+    avr_sleep_queue = last->next;
+    last->next = NULL;
+    *avr_sleep_expired_tail = head;
+    avr_sleep_expired_tail = &last->next;
+}
+
+uint8_t avr_coro_sleep_dispatch(void)
+{
+    avr_sleeper_t *sleeper;
+    uint8_t sreg, count = 0;
+    for (;;)
+    {
+        sreg = SREG;
+        __asm__ __volatile__("cli\n" ::: "memory");
+        sleeper = avr_sleep_expired;
+        if (sleeper != NULL)
+        {
+            avr_sleep_expired = sleeper->next;
+            if (avr_sleep_expired == NULL)
+            {
+                avr_sleep_expired_tail = &avr_sleep_expired;
+            }
+        }
+        SREG = sreg;
+        if (sleeper == NULL)
+        {
+            break;
+        }
+        /* the sleeper is valid until the coroutine gets resumed */
+        avr_coro_resume(sleeper->coro, NULL);
+        count++;
+    }
+    return count;
+}
+
+#endif /* __AVR__ */
+#endif /* AVRSLEEP_IMPL_H */
@@ -0,0 +1,522 @@
+/*
+This sketch measures how many CPU cycles the primitives of the library
+take: avr_getcontext(), avr_setcontext(), avr_swapcontext(),
+avr_makecontext(), avr_initcontext(), their cooperative counterparts,
+avr_coro_init(), avr_coro_reset(), avr_coro_resume() and
+avr_coro_yield(), their unchecked counterparts, and the error
+recovery functions avr_try() and avr_throw().
+
+Every primitive gets timed SAMPLES times with a 16-bit timer running
+at the CPU clock (Timer1 at clk/1 on the classic AVR devices, TCB0 at
+CLK_PER/1 on the megaAVR ones). Interrupts are disabled while
+sampling. The cost of reading the timer gets measured beforehand and
+subtracted from every sample.
+
+The header line names the CPU core the sketch runs on: "AVRe" for the
+classic AVR devices (e.g. ATmega328P) or "AVRxt" for the megaAVR ones
+(e.g. ATmega4809), which have different instruction timings and get
+slightly different context switching code (see AVR_CONTEXT_AVRXT).
+Please run it on both kinds of boards to compare the cores.
+
+The switching primitives get timed one way: from the moment right
+before the call to the moment the other context starts executing. For
+avr_setcontext() it is the time between the call and the return from
+the avr_getcontext() call which saved the context, and for
+avr_throw() it is the time between the call and the second return from
+avr_try().
+
+When being uploaded to an Arduino board, this sketch prints the
+results once via serial port in the machine-readable CSV format, e.g.:
+
+# avr-context benchmark, F_CPU=16000000, timer=Timer1, core=AVRe
+primitive,min,avg,max
+avr_getcontext,...
+...
+# done
+
+After that, the sketch halts the MCU by entering sleep mode with
+interrupts disabled. Press the reset button to run it again. This also
+makes it possible to run the sketch headlessly in a simulator, e.g.
+(simavr quits when the simulated MCU halts this way):
+
+simavr -m atmega328p -f 16000000 01.Context_Switching_Cycles.ino.elf
+
+simavr does not model the megaAVR 0-series devices (e.g. ATmega4809),
+so there is no headless way to run the sketch on them: it has to be
+run on a board, and the results get read via serial port.
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avr/sleep.h>
+
+#include <avrcontext_arduino.h>
+
+#define SAMPLES 64
+#define STACK_SIZE 128
+
+//// Timer
+
+#if defined(TCNT1)
+#define BENCH_TIMER_NAME "Timer1"
+#define BENCH_TIMER TCNT1
+static void bench_timer_start(void)
+{
+    TCCR1A = 0;
+    TCCR1B = 1 << CS10; // clk/1
+    TIMSK1 = 0;
+}
+#elif defined(TCB0)
+#define BENCH_TIMER_NAME "TCB0"
+#define BENCH_TIMER TCB0.CNT
+static void bench_timer_start(void)
+{
+    TCB0.CTRLA = 0;
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc; // periodic interrupt mode
+    TCB0.INTCTRL = 0;
+    TCB0.CCMP = 0xFFFF;
+    TCB0.CNT = 0;
+    TCB0.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_ENABLE_bm; // CLK_PER/1
+}
+#else
+#error "This sketch needs Timer1 or TCB0."
+#endif
+
+#if AVR_CONTEXT_AVRXT
+#define BENCH_CORE_NAME "AVRxt"
+#else
+#define BENCH_CORE_NAME "AVRe"
+#endif
+
+//// Statistics
+
+typedef struct bench_stats_t_ {
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint16_t count;
+} bench_stats_t;
+
+static volatile uint16_t bench_start, bench_stop; // timestamps
+static uint16_t bench_overhead; // the cost of taking the timestamps
+static bench_stats_t stats;
+
+static void stats_reset(void)
+{
+    stats.min = UINT16_MAX;
+    stats.max = 0;
+    stats.sum = 0;
+    stats.count = 0;
+}
+
+static void stats_add(void)
+{
+    uint16_t cycles = bench_stop - bench_start;
+    cycles = cycles > bench_overhead ? cycles - bench_overhead : 0;
+    if (cycles < stats.min)
+    {
+        stats.min = cycles;
+    }
+    if (cycles > stats.max)
+    {
+        stats.max = cycles;
+    }
+    stats.sum += cycles;
+    stats.count++;
+}
+
+static void stats_report(const __FlashStringHelper *name)
+{
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print(stats.min);
+    Serial.print(',');
+    Serial.print((uint16_t)(stats.sum / stats.count));
+    Serial.print(',');
+    Serial.println(stats.max);
+}
+
+//// Contexts
+
+static uint8_t peer_stack[STACK_SIZE];
+static avr_context_t main_ctx, peer_ctx;
+static avr_coop_context_t main_coop_ctx, peer_coop_ctx;
+static avr_coro_t coro;
+static volatile uint8_t jumped;
+static volatile uint8_t sampling_resume;
+
+static void swap_peer(void *)
+{
+    for (;;)
+    {
+        bench_stop = BENCH_TIMER;
+        avr_swapcontext(&peer_ctx, &main_ctx);
+    }
+}
+
+static void swap_coop_peer(void *)
+{
+    for (;;)
+    {
+        bench_stop = BENCH_TIMER;
+        avr_swapcontext_coop(&peer_ctx, &main_ctx);
+    }
+}
+
+static void coop_swap_peer(void *)
+{
+    for (;;)
+    {
+        bench_stop = BENCH_TIMER;
+        avr_coop_swapcontext(&peer_coop_ctx, &main_coop_ctx);
+    }
+}
+
+// resume: bench_start (invoker) -> bench_stop (coroutine)
+// yield: bench_start (coroutine) -> bench_stop (invoker)
+static void *coro_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        bench_stop = BENCH_TIMER;
+        if (sampling_resume)
+        {
+            stats_add();
+        }
+        bench_start = BENCH_TIMER;
+        avr_coro_yield(self, NULL);
+    }
+    return NULL; // unreachable
+}
+
+static void *coro_unchecked_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        bench_stop = BENCH_TIMER;
+        if (sampling_resume)
+        {
+            stats_add();
+        }
+        bench_start = BENCH_TIMER;
+        avr_coro_yield_unchecked(self, NULL);
+    }
+    return NULL; // unreachable
+}
+
+//// Benchmarks
+
+static void bench_overhead_measure(void)
+{
+    bench_overhead = 0;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    bench_overhead = stats.min;
+}
+
+static void bench_getcontext(void)
+{
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_getcontext(&main_ctx);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_getcontext"));
+}
+
+static void bench_setcontext(void)
+{
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        jumped = 0;
+        avr_getcontext(&main_ctx);
+        if (!jumped)
+        {
+            jumped = 1;
+            bench_start = BENCH_TIMER;
+            avr_setcontext(&main_ctx);
+        }
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_setcontext"));
+}
+
+static void bench_makecontext(void)
+{
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_makecontext(&peer_ctx,
+                        &peer_stack[0], sizeof(peer_stack),
+                        &main_ctx,
+                        swap_peer, NULL);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_makecontext"));
+}
+
+static void bench_initcontext(void)
+{
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_initcontext(&peer_ctx,
+                        &peer_stack[0], sizeof(peer_stack),
+                        &main_ctx,
+                        swap_peer, NULL, 0);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_initcontext"));
+}
+
+static void bench_swapcontext(avr_context_func_t peer, void (*swap)(avr_context_t *, const avr_context_t *),
+                              const __FlashStringHelper *name)
+{
+    avr_getcontext(&peer_ctx);
+    avr_makecontext(&peer_ctx,
+                    &peer_stack[0], sizeof(peer_stack),
+                    &main_ctx,
+                    peer, NULL);
+    swap(&main_ctx, &peer_ctx); // start the peer
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        swap(&main_ctx, &peer_ctx);
+        stats_add();
+    }
+    sei();
+    stats_report(name);
+}
+
+static void bench_coop_swapcontext(void)
+{
+    avr_coop_getcontext(&peer_coop_ctx);
+    avr_coop_makecontext(&peer_coop_ctx,
+                         &peer_stack[0], sizeof(peer_stack),
+                         &main_coop_ctx,
+                         coop_swap_peer, NULL);
+    avr_coop_swapcontext(&main_coop_ctx, &peer_coop_ctx); // start the peer
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_coop_swapcontext(&main_coop_ctx, &peer_coop_ctx);
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_coop_swapcontext"));
+}
+
+static void bench_coro_init(void)
+{
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_coro_init(&coro, &peer_stack[0], sizeof(peer_stack), coro_func);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_coro_init"));
+}
+
+static void *dead_func(avr_coro_t *, void *)
+{
+    return NULL;
+}
+
+static void bench_coro_reset(void)
+{
+    avr_coro_init(&coro, &peer_stack[0], sizeof(peer_stack), dead_func);
+    avr_coro_resume(&coro, NULL); // now it is dead
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_coro_reset(&coro, dead_func);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+        avr_coro_resume(&coro, NULL); // let it die again
+    }
+    sei();
+    stats_report(F("avr_coro_reset"));
+}
+
+static void bench_coro(void)
+{
+    bench_stats_t resume_stats;
+    avr_coro_init(&coro, &peer_stack[0], sizeof(peer_stack), coro_func);
+    sampling_resume = 0;
+    avr_coro_resume(&coro, NULL); // start the coroutine
+    // the coroutine collects the samples for avr_coro_resume()
+    sampling_resume = 1;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_coro_resume(&coro, NULL);
+    }
+    sei();
+    resume_stats = stats;
+    // the invoker collects the samples for avr_coro_yield()
+    sampling_resume = 0;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        avr_coro_resume(&coro, NULL);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_coro_yield"));
+    stats = resume_stats;
+    stats_report(F("avr_coro_resume"));
+}
+
+static void bench_coro_unchecked(void)
+{
+    bench_stats_t resume_stats;
+    avr_coro_init(&coro, &peer_stack[0], sizeof(peer_stack), coro_unchecked_func);
+    sampling_resume = 0;
+    avr_coro_resume_unchecked(&coro, NULL); // start the coroutine
+    sampling_resume = 1;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        avr_coro_resume_unchecked(&coro, NULL);
+    }
+    sei();
+    resume_stats = stats;
+    sampling_resume = 0;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        avr_coro_resume_unchecked(&coro, NULL);
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_coro_yield_unchecked"));
+    stats = resume_stats;
+    stats_report(F("avr_coro_resume_unchecked"));
+}
+
+static void bench_try(void)
+{
+    avr_try_t frame;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        bench_start = BENCH_TIMER;
+        if (avr_try(&frame) == 0)
+        {
+            bench_stop = BENCH_TIMER;
+            avr_try_end(&frame);
+        }
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_try"));
+}
+
+static void bench_throw(void)
+{
+    avr_try_t frame;
+    stats_reset();
+    cli();
+    for (uint16_t i = 0; i < SAMPLES; i++)
+    {
+        if (avr_try(&frame) == 0)
+        {
+            bench_start = BENCH_TIMER;
+            avr_throw(1);
+        }
+        bench_stop = BENCH_TIMER;
+        stats_add();
+    }
+    sei();
+    stats_report(F("avr_throw"));
+}
+
+// Sampling is done with interrupts disabled, reporting is not.
+static void bench_run(void)
+{
+    bench_overhead_measure();
+    Serial.println(F("primitive,min,avg,max"));
+    bench_getcontext();
+    bench_setcontext();
+    bench_makecontext();
+    bench_initcontext();
+    bench_swapcontext(swap_peer, avr_swapcontext, F("avr_swapcontext"));
+    bench_swapcontext(swap_coop_peer, avr_swapcontext_coop, F("avr_swapcontext_coop"));
+    bench_coop_swapcontext();
+    bench_coro_init();
+    bench_coro_reset();
+    bench_coro();
+    bench_coro_unchecked();
+    bench_try();
+    bench_throw();
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+    bench_timer_start();
+    Serial.print(F("# avr-context benchmark, F_CPU="));
+    Serial.print(F_CPU);
+    Serial.println(F(", timer=" BENCH_TIMER_NAME ", core=" BENCH_CORE_NAME));
+    bench_run();
+    Serial.println(F("# done"));
+    Serial.flush();
+    // halt
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    cli();
+    sleep_enable();
+    sleep_cpu();
+}
+
+void loop(void)
+{
+    // unreachable
+}
@@ -0,0 +1,105 @@
+/*
+This sketch demonstrates the sampling profiler (see avrprof.h).
+
+Timer1 interrupts the running code approximately 1000 times per
+second. The interrupt routine defined by AVR_PROF_ISR saves the
+context of the interrupted code and bins its program counter into a
+histogram which covers the whole program memory. The sampling period
+(1995 timer ticks) is chosen to be not a multiple of the periods of
+the profiled code.
+
+The main loop calls two functions: slow_sum() takes approximately ten
+times longer than fast_sum(). After five seconds, sampling gets
+stopped, and the histogram gets printed once via serial port, e.g.:
+
+# avr-prof
+range,0x000000,0x008000,512
+0x000200,41
+0x000400,4498
+0x000600,455
+other,0
+total,4994
+# end
+
+The bin addresses could be mapped to the functions using the symbol
+table of the ELF file, e.g.:
+
+avr-nm -n --defined-only 02.Sampling_Profiler.ino.elf
+
+After that, the sketch halts the MCU by entering sleep mode with
+interrupts disabled. Press the reset button to run it again. This
+sketch is meant to be run on the classic AVR devices (e.g. ATmega328P
+based Arduino boards).
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avr/sleep.h>
+
+#include <avrcontext_arduino.h>
+
+#define PROFILE_MS 5000
+
+AVR_PROF_ISR(TIMER1_COMPA_vect)
+
+static volatile uint32_t result;
+
+static void __attribute__((noinline)) slow_sum(void)
+{
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < 2000; i++)
+    {
+        sum += (uint32_t)i * i;
+    }
+    result = sum;
+}
+
+static void __attribute__((noinline)) fast_sum(void)
+{
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < 200; i++)
+    {
+        sum += (uint32_t)i * i;
+    }
+    result = sum;
+}
+
+static void serial_putc(char c)
+{
+    Serial.write(c);
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_prof_init(0, (uint32_t)FLASHEND + 1);
+    // Timer1: CTC mode, clk/8, approximately 1 kHz at 16 MHz
+    TCCR1A = 0;
+    TCCR1B = 1 << WGM12 | 1 << CS11;
+    OCR1A = (uint16_t)(F_CPU / 8 / 1000) - 6;
+    TIMSK1 = 1 << OCIE1A;
+    avr_prof_start();
+}
+
+void loop(void)
+{
+    slow_sum();
+    fast_sum();
+    if (millis() >= PROFILE_MS)
+    {
+        avr_prof_stop();
+        TIMSK1 = 0;
+        avr_prof_dump(serial_putc);
+        Serial.flush();
+        // halt
+        set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+        cli();
+        sleep_enable();
+        sleep_cpu();
+    }
+}
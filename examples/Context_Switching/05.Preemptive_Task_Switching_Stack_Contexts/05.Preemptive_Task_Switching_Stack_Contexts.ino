@@ -0,0 +1,134 @@
+/*
+This example is a version of the Preemptive Task Switching example
+which keeps task contexts on the tasks' own stacks. It is implemented
+on top of avr_stack_makecontext(), AVR_SAVE_CONTEXT_STACK_GLOBAL_POINTER(),
+AVR_RESTORE_CONTEXT_STACK_GLOBAL_POINTER() and a hardware timer, which
+generates interrupts.
+
+As in the other example, there are two tasks, both run indefinitely:
+one enables the built-in LED, the other one disables it. System timer,
+which is implemented on top of watchdog running in interrupt mode,
+ticks every one second and switches the tasks in Round Robin fashion
+during the tick.
+
+The difference is in the way the task contexts get saved. During the
+tick, the registers of the interrupted task get pushed onto its own
+stack and only the stack pointer (2 bytes) gets stored in the 'tasks'
+array. This is how most of the RTOS ports for AVR do it: the task
+switching code is shorter and the task control blocks are smaller.
+
+As the initial execution context of the MCU gets converted into a
+switchable task, its context gets pushed onto the main stack during
+the first tick.
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avr/wdt.h>
+#include <avr/sleep.h>
+
+#include <avrcontext_arduino.h>
+
+//// Global variables
+
+extern "C" {
+avr_stack_context_t *volatile current_task_ctx; // current task context
+}
+static size_t current_task_num; // current task index
+static avr_context_t dummy_ctx; // never going to be used
+static avr_stack_context_t tasks[2]; // contexts for tasks (stack pointers)
+static uint8_t disabler_stack[128]; // stack for the disabler_task
+
+// This function is the second task body.
+// It tries to disable the built-in LED (forever).
+static void disabler_task(void *)
+{
+    for (;;)
+    {
+        digitalWrite(LED_BUILTIN, LOW);
+    }
+}
+
+// This function starts system timer. We use the watchdog timer
+// because it is unused by default on Arduino boards.
+void start_system_timer(void)
+{
+    cli(); // disable interrupts
+    MCUSR &= ~(1<<WDRF);
+    wdt_reset(); // reset watchdog timer
+    // configure WD timer
+    WDTCSR |= 1 << WDCE | 1 << WDE; // enable WD timer configuration mode
+    WDTCSR = 0; // reset WD timer
+    wdt_enable(WDTO_1S); // configure period
+    WDTCSR |= 1 << WDIE; // use WD timer in interrupt mode
+    sei(); // enable interrupts
+}
+
+void setup(void)
+{
+    // Enable builtin LED
+    pinMode(LED_BUILTIN, OUTPUT);
+    digitalWrite(LED_BUILTIN, LOW);
+
+    // Initialise dummy context.
+    //
+    // Our tasks run code in endless loops, so this context never gets
+    // activated.
+    avr_getcontext(&dummy_ctx);
+
+    // Initialise the first task.
+    //
+    // Convert the currently running code into a first task. When the
+    // system timer ticks for the first time, the current execution
+    // context is going to be pushed onto the main stack and the stack
+    // pointer is going to be saved into tasks[0].
+    current_task_num = 0;
+    current_task_ctx = &tasks[0];
+
+    // Initialise the second task.
+    //
+    // The initial register values get pushed onto the task stack, there is
+    // no need to call avr_getcontext() beforehand.
+    avr_stack_makecontext(&tasks[1],
+                          (void*)&disabler_stack[0], sizeof(disabler_stack),
+                          &dummy_ctx,
+                          disabler_task, NULL);
+    // start scheduling
+    start_system_timer();
+    // after returning from this function
+    // loop() gets executed (as usual).
+}
+
+// This code tries to enable built-in LED (forever).
+void loop(void)
+{
+    digitalWrite(LED_BUILTIN, HIGH);
+}
+
+static void switch_task(void)
+{
+    current_task_num = current_task_num == 0 ? 1 : 0;
+    current_task_ctx = &tasks[current_task_num];
+}
+
+// System Timer Interrupt System Routine.
+//
+// Please keep in mind that ISR_NAKED attribute is important, because
+// we have to save the current task execution context without changing
+// it.
+ISR(WDT_vect, ISR_NAKED)
+{
+    // push the context of the current task onto its stack
+    AVR_SAVE_CONTEXT_STACK_GLOBAL_POINTER(
+        "cli\n", // disable interrupts during task switching
+        current_task_ctx);
+    switch_task(); // switch to the other task.
+    WDTCSR |= 1 << WDIE; // re-enable watchdog timer interrupts to avoid reset
+    // restore the context of the task to which we have just switched.
+    AVR_RESTORE_CONTEXT_STACK_GLOBAL_POINTER(current_task_ctx);
+    asm volatile("reti\n"); // return from the interrupt and activate the restored context.
+}
@@ -0,0 +1,125 @@
+/*
+This example is a version of the Preemptive Task Switching example
+in which the timer interrupt does its work in an ordinary C function
+and switches the tasks only once in a while. It is implemented on top
+of avr_getcontext(), avr_makecontext(), AVR_ISR_SWITCH_GLOBAL_POINTER()
+and a hardware timer, which generates interrupts.
+
+As in the other example, there are two tasks, both run indefinitely:
+one enables the built-in LED, the other one disables it. Timer1 ticks
+every millisecond, like a control loop timer would. Its handler,
+control_tick(), counts the ticks and requests a task switch on every
+500th of them. Thus, the LED blinks once a second.
+
+The difference is in the way the interrupt routine saves the context.
+On every tick, only the registers which a C function may clobber get
+pushed onto the stack, the same way the compiler would do it for an
+ordinary interrupt routine. The rest of the context gets saved only
+when control_tick() requests a switch, so most of the ticks keep the
+interrupts disabled for a much shorter time than the tick of the
+Preemptive Task Switching example does.
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define TICKS_PER_SWITCH 500
+
+//// Global variables
+
+extern "C" {
+avr_context_t *volatile current_task_ctx; // current task context
+}
+static size_t current_task_num; // current task index
+static avr_context_t dummy_ctx; // never going to be used
+static avr_context_t tasks[2]; // contexts for tasks
+static uint8_t disabler_stack[128]; // stack for the disabler_task
+static uint16_t ticks; // ticks since the last switch
+
+// This function is the second task body.
+// It tries to disable the built-in LED (forever).
+static void disabler_task(void *)
+{
+    for (;;)
+    {
+        digitalWrite(LED_BUILTIN, LOW);
+    }
+}
+
+// This function starts the 1 kHz timer (Timer1 in CTC mode).
+static void start_control_timer(void)
+{
+    cli(); // disable interrupts
+    TCCR1A = 0;
+    TCCR1B = 1 << WGM12 | 1 << CS11 | 1 << CS10; // CTC, clk/64
+    OCR1A = F_CPU / 64 / 1000 - 1;
+    TCNT1 = 0;
+    TIMSK1 = 1 << OCIE1A;
+    sei(); // enable interrupts
+}
+
+void setup(void)
+{
+    // Enable builtin LED
+    pinMode(LED_BUILTIN, OUTPUT);
+    digitalWrite(LED_BUILTIN, LOW);
+
+    // Our tasks run code in endless loops, so this context never gets
+    // activated.
+    avr_getcontext(&dummy_ctx);
+
+    // Convert the currently running code into the first task: its
+    // context gets saved into tasks[0] on the first switch.
+    current_task_num = 0;
+    current_task_ctx = &tasks[0];
+
+    // Initialise the second task. It starts execution on the first
+    // switch.
+    avr_getcontext(&tasks[1]);
+    avr_makecontext(&tasks[1],
+                    (void*)&disabler_stack[0], sizeof(disabler_stack),
+                    &dummy_ctx,
+                    disabler_task, NULL);
+    start_control_timer();
+}
+
+// This code tries to enable built-in LED (forever).
+void loop(void)
+{
+    digitalWrite(LED_BUILTIN, HIGH);
+}
+
+// The tick handler: an ordinary C function. A real control loop
+// would read its sensors and update its outputs here. It returns
+// non-zero to request a task switch.
+static uint8_t control_tick(void)
+{
+    if (++ticks < TICKS_PER_SWITCH)
+    {
+        return 0;
+    }
+    ticks = 0;
+    return 1;
+}
+
+static void switch_task(void)
+{
+    current_task_num = current_task_num == 0 ? 1 : 0;
+    current_task_ctx = &tasks[current_task_num];
+}
+
+// Timer Interrupt System Routine.
+//
+// It has to be naked, as AVR_ISR_SWITCH_GLOBAL_POINTER saves the
+// registers by itself. The interrupts remain disabled while the
+// contexts get switched, as the CPU disables them when it enters the
+// routine.
+ISR(TIMER1_COMPA_vect, ISR_NAKED)
+{
+    AVR_ISR_SWITCH_GLOBAL_POINTER(control_tick, "", switch_task(), current_task_ctx);
+}
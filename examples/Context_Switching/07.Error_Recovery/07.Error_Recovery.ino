@@ -0,0 +1,170 @@
+/*
+This example demonstrates how avr_try() and avr_throw() could be used
+to recover from errors deep inside a parser without checking return
+values at every level.
+
+There are three byte streams of packets. Every packet consists of the
+payload length, the packet type, the payload (a 16-bit big-endian
+value) and the checksum (the sum of the type and the payload bytes).
+The function next_byte() throws an error when the stream ends in the
+middle of a packet, and parse_packet() throws one when the checksum
+does not match or the type is unknown.
+
+There are two nested protected regions. The inner one, in
+process_packet(), handles the unknown packet types by skipping the
+packet, and passes the rest of the errors on to the outer one by
+throwing them again. The outer one, in parse_stream(), gives up on the
+stream. The counter of the parsed packets is modified within the outer
+region, so it is declared "volatile" to keep its value when an error
+gets thrown.
+
+When being uploaded to an Arduino board, this sketch produces the
+following output via serial port once:
+
+stream 0:
+temperature: 25
+skipping an unknown packet
+humidity: 45
+3 packets parsed
+stream 1:
+temperature: 26
+error 2 after 1 packets
+stream 2:
+error 1 after 0 packets
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define ERROR_TRUNCATED 1
+#define ERROR_CHECKSUM 2
+#define ERROR_TYPE 3
+
+typedef struct cursor_t {
+    const uint8_t *pos;
+    const uint8_t *end;
+} cursor_t;
+
+static const uint8_t stream0[] = {
+    2, 'T', 0x00, 0x19, 0x6D,
+    2, 'X', 0x00, 0x07, 0x5F,
+    2, 'H', 0x00, 0x2D, 0x75,
+};
+
+static const uint8_t stream1[] = {
+    2, 'T', 0x00, 0x1A, 0x6E,
+    2, 'T', 0x00, 0x1B, 0x00, // wrong checksum
+    2, 'H', 0x00, 0x2E, 0x76,
+};
+
+static const uint8_t stream2[] = {
+    2, 'T', 0x00, // truncated
+};
+
+static uint8_t next_byte(cursor_t *cursor)
+{
+    if (cursor->pos == cursor->end)
+    {
+        avr_throw(ERROR_TRUNCATED);
+    }
+    return *cursor->pos++;
+}
+
+static void parse_packet(cursor_t *cursor)
+{
+    uint8_t len = next_byte(cursor);
+    uint8_t type = next_byte(cursor);
+    uint8_t sum = type;
+    uint16_t value = 0;
+    for (uint8_t i = 0; i < len; i++)
+    {
+        uint8_t b = next_byte(cursor);
+        sum += b;
+        value = value << 8 | b;
+    }
+    if (next_byte(cursor) != sum)
+    {
+        avr_throw(ERROR_CHECKSUM);
+    }
+    switch (type)
+    {
+        case 'T':
+            Serial.print(F("temperature: "));
+            break;
+        case 'H':
+            Serial.print(F("humidity: "));
+            break;
+        default:
+            avr_throw(ERROR_TYPE);
+    }
+    Serial.println(value);
+}
+
+static void process_packet(cursor_t *cursor)
+{
+    avr_try_t frame;
+    int error = avr_try(&frame);
+    if (error == 0)
+    {
+        parse_packet(cursor);
+        avr_try_end(&frame);
+    }
+    else if (error == ERROR_TYPE)
+    {
+        // the packet has been read completely, so it is safe to skip it
+        Serial.println(F("skipping an unknown packet"));
+    }
+    else
+    {
+        // pass the error on to the enclosing region
+        avr_throw(error);
+    }
+}
+
+static void parse_stream(const uint8_t *data, size_t size)
+{
+    cursor_t cursor = { data, data + size };
+    volatile uint8_t packets = 0;
+    avr_try_t frame;
+    int error = avr_try(&frame);
+    if (error == 0)
+    {
+        while (cursor.pos != cursor.end)
+        {
+            process_packet(&cursor);
+            packets++;
+        }
+        avr_try_end(&frame);
+        Serial.print(packets);
+        Serial.println(F(" packets parsed"));
+    }
+    else
+    {
+        Serial.print(F("error "));
+        Serial.print(error);
+        Serial.print(F(" after "));
+        Serial.print(packets);
+        Serial.println(F(" packets"));
+    }
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    Serial.println(F("stream 0:"));
+    parse_stream(stream0, sizeof(stream0));
+    Serial.println(F("stream 1:"));
+    parse_stream(stream1, sizeof(stream1));
+    Serial.println(F("stream 2:"));
+    parse_stream(stream2, sizeof(stream2));
+}
+
+void loop()
+{
+}
@@ -0,0 +1,87 @@
+/*
+This example demonstrates how the peak stack usage of a coroutine can
+be measured.
+
+The coroutine stack gets painted by avr_stack_paint() before
+avr_coro_init(). Every time the coroutine gets resumed, it calls a
+recursive function one level deeper than before and yields from the
+deepest level. After every resumption, the invoker prints the peak
+stack usage reported by avr_stack_used(). After MAX_DEPTH levels, the
+coroutine stops going deeper.
+
+When the library is compiled with AVR_CONTEXT_STACK_PAINT defined to a
+non-zero value (see avrcontext.h), avr_coro_init() paints the stack by
+itself, and avr_coro_stack_used() can be used instead.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+depth: 1, stack used: 32 of 256
+depth: 2, stack used: 40 of 256
+depth: 3, stack used: 48 of 256
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 256
+#define MAX_DEPTH 16
+
+static avr_coro_t coro;
+static uint8_t stack[STACK_SIZE];
+
+static uint8_t descend(avr_coro_t *self, uint8_t depth)
+{
+    volatile uint8_t frame[4]; // make every level use some stack
+    frame[0] = depth;
+    if (depth > 1)
+    {
+        return descend(self, depth - 1) + frame[0];
+    }
+    avr_coro_yield(self, NULL);
+    return frame[0];
+}
+
+static void *coro_func(avr_coro_t *self, void *)
+{
+    uint8_t depth = 1;
+    for (;;)
+    {
+        descend(self, depth);
+        if (depth < MAX_DEPTH)
+        {
+            depth++;
+        }
+    }
+    return NULL; // unreachable
+}
+
+static uint8_t depth;
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    avr_stack_paint(&stack[0], sizeof(stack));
+    avr_coro_init(&coro, &stack[0], sizeof(stack), coro_func);
+}
+
+void loop() {
+    avr_coro_resume(&coro, NULL);
+    if (depth < MAX_DEPTH)
+    {
+        depth++;
+    }
+    Serial.print(F("depth: "));
+    Serial.print(depth);
+    Serial.print(F(", stack used: "));
+    Serial.print(avr_stack_used(&stack[0], sizeof(stack)));
+    Serial.print(F(" of "));
+    Serial.println(sizeof(stack));
+    delay(1000);
+}
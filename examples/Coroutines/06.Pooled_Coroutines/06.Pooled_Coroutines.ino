@@ -0,0 +1,109 @@
+/*
+This example demonstrates how short-lived coroutines can get their
+stacks from a stack pool instead of a dedicated static array each.
+
+Three stacks are carved out of a single static arena. Every second a
+new request arrives, and a coroutine gets created by
+avr_coro_init_pooled() to handle it. A request takes a few steps to
+complete, so several of them are handled concurrently. The handlers
+get resumed in turn, and their stacks return to the pool when they
+become dead. A request which arrives when the pool is exhausted gets
+rejected.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+request 0: started
+request 0: step 1
+request 1: started
+request 0: step 2
+request 1: step 1
+request 2: started
+request 0: step 3
+request 1: step 2
+request 2: step 1
+request 3: rejected
+request 0: step 4
+request 1: step 3
+request 2: step 2
+request 4: started
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define POOL_BLOCKS 3
+#define BLOCK_SIZE 128
+#define STEPS 4
+
+static uint8_t arena[POOL_BLOCKS * BLOCK_SIZE];
+static avr_stack_pool_t pool;
+static avr_coro_t handlers[POOL_BLOCKS];
+static bool active[POOL_BLOCKS];
+static unsigned int next_request;
+
+static void *handler_func(avr_coro_t *self, void *arg)
+{
+    unsigned int request = (unsigned int)(uintptr_t)arg;
+    Serial.print(F("request "));
+    Serial.print(request);
+    Serial.println(F(": started"));
+    for (uint8_t step = 1; step <= STEPS; step++)
+    {
+        avr_coro_yield(self, NULL); // wait for the next turn
+        Serial.print(F("request "));
+        Serial.print(request);
+        Serial.print(F(": step "));
+        Serial.println(step);
+    }
+    return NULL; // the stack goes back to the pool
+}
+
+static void accept_request(void)
+{
+    unsigned int request = next_request++;
+    for (uint8_t i = 0; i < POOL_BLOCKS; i++)
+    {
+        if (!active[i])
+        {
+            if (avr_coro_init_pooled(&handlers[i], &pool, handler_func) == 0)
+            {
+                // The request number is passed on at the first resumption.
+                void *data = (void *)(uintptr_t)request;
+                active[i] = true;
+                avr_coro_resume(&handlers[i], &data);
+                return;
+            }
+            break;
+        }
+    }
+    Serial.print(F("request "));
+    Serial.print(request);
+    Serial.println(F(": rejected"));
+}
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    avr_stack_pool_init(&pool, &arena[0], sizeof(arena), BLOCK_SIZE);
+}
+
+void loop() {
+    // Give every handler a turn, then accept a new request.
+    for (uint8_t i = 0; i < POOL_BLOCKS; i++)
+    {
+        if (active[i])
+        {
+            avr_coro_resume(&handlers[i], NULL);
+            active[i] = avr_coro_state(&handlers[i]) != AVR_CORO_DEAD;
+        }
+    }
+    accept_request();
+    delay(1000);
+}
@@ -0,0 +1,98 @@
+/*
+This example demonstrates how control can be passed from one
+coroutine to the other directly by avr_coro_transfer().
+
+It is a version of the "Symmetric Coroutines via Asymmetric Ones"
+example, where every switch between the coroutines costs two context
+switches: the coroutine yields to the dispatching loop, which resumes
+the other coroutine. Here the invoker only starts the first coroutine,
+and the coroutines pass control to each other with a single context
+switch. The other coroutine takes over the invoker of the first one:
+when the first coroutine dies, control returns to the invoker.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port every two seconds:
+
+Starting coroutines...
+
+Coroutine 0 counts i=0 (&i=0x18A)
+Coroutine 1 counts i=0 (&i=0x20A)
+Coroutine 0 counts i=1 (&i=0x18A)
+Coroutine 1 counts i=1 (&i=0x20A)
+Coroutine 0 counts i=2 (&i=0x18A)
+Coroutine 1 counts i=2 (&i=0x20A)
+Coroutine 0 counts i=3 (&i=0x18A)
+Coroutine 1 counts i=3 (&i=0x20A)
+Coroutine 0 counts i=4 (&i=0x18A)
+Coroutine 1 counts i=4 (&i=0x20A)
+Done.
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 128
+
+static uint8_t stack[2][STACK_SIZE];       // a stack for each coroutine
+static avr_coro_t coroutine_state[2];      // container to remember context
+static size_t coroutine_numbers[2] = {0, 1};
+
+// switch current coroutine (0 -> 1 -> 0 -> 1 ...)
+static void transfer_to_next(avr_coro_t *self, const size_t current_num)
+{
+    // The number of the next coroutine gets passed to it: this way
+    // it learns its number when it gets activated for the first time.
+    size_t next = current_num == 1 ? 0 : 1;
+    void *data = &coroutine_numbers[next];
+    avr_coro_transfer(self, &coroutine_state[next], &data);
+}
+
+static void *coroutine(avr_coro_t *self, size_t *data)
+{
+    const size_t coroutine_number = *data;
+    for (size_t i = 0; i < 5; i++)
+    {
+        Serial.print(F("Coroutine "));
+        Serial.print(coroutine_number);
+        Serial.print(F(" counts i="));
+        Serial.print(i);
+        Serial.print(F(" (&i=0x"));
+        Serial.print((uintptr_t)&i, HEX);
+        Serial.println(F(")"));
+        transfer_to_next(self, coroutine_number);
+    }
+    return NULL;
+}
+
+static void coroutines_example(void)
+{
+    for (size_t i = 0; i < 2; i++)
+    {
+        avr_coro_init(&coroutine_state[i],
+                      (void *)stack[i], STACK_SIZE,
+                      (avr_coro_func_t)coroutine);
+    }
+    Serial.println(F("Starting coroutines...\n"));
+    void *data = (void *)&coroutine_numbers[0];
+    // Returns when the first coroutine dies: it is the one which
+    // reaches the end of its function first.
+    avr_coro_resume(&coroutine_state[0], &data);
+    Serial.println(F("Done.\n"));
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+}
+
+void loop(void)
+{
+    delay(2000);
+    coroutines_example();
+}
@@ -0,0 +1,95 @@
+/*
+This example demonstrates how coroutines can exchange items over a
+channel instead of passing them via avr_coro_resume() and
+avr_coro_yield() one by one.
+
+The producer reads the analog input A0 and sends the samples in
+batches of four into a channel, which can hold up to sixteen of them.
+It yields only when the channel is full. The consumer receives all of
+the samples from the channel at once and prints them. It yields only
+when the channel is empty. The loop() function resumes the two
+coroutines in turn and counts the resumptions.
+
+Passing the samples one by one would take one resumption per sample.
+Here it takes two resumptions per sixteen samples.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port every second:
+
+resumptions: 2, received 16 samples: 312 310 309 ...
+resumptions: 4, received 16 samples: 308 311 310 ...
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 128
+#define CAPACITY 16
+#define BATCH 4
+
+static avr_coro_t producer, consumer;
+static uint8_t producer_stack[STACK_SIZE], consumer_stack[STACK_SIZE];
+static uint16_t channel_buffer[CAPACITY];
+static avr_chan_t channel;
+static unsigned long resumptions;
+
+static void *producer_func(avr_coro_t *self, void *)
+{
+    uint16_t batch[BATCH];
+    for (;;)
+    {
+        for (uint8_t i = 0; i < BATCH; i++)
+        {
+            batch[i] = analogRead(A0);
+        }
+        // yields only when the channel is full
+        avr_chan_send(&channel, self, &batch[0], BATCH);
+    }
+    return NULL;
+}
+
+static void *consumer_func(avr_coro_t *self, void *)
+{
+    uint16_t samples[CAPACITY];
+    for (;;)
+    {
+        // yields only when the channel is empty
+        size_t received = avr_chan_recv(&channel, self, &samples[0], CAPACITY);
+        Serial.print(F("resumptions: "));
+        Serial.print(resumptions);
+        Serial.print(F(", received "));
+        Serial.print(received);
+        Serial.print(F(" samples:"));
+        for (size_t i = 0; i < received; i++)
+        {
+            Serial.print(' ');
+            Serial.print(samples[i]);
+        }
+        Serial.println();
+        delay(1000);
+    }
+    return NULL;
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_chan_init(&channel, &channel_buffer[0], CAPACITY, sizeof(channel_buffer[0]));
+    avr_coro_init(&producer, &producer_stack[0], STACK_SIZE, producer_func);
+    avr_coro_init(&consumer, &consumer_stack[0], STACK_SIZE, consumer_func);
+}
+
+void loop()
+{
+    resumptions++;
+    avr_coro_resume(&producer, NULL);
+    resumptions++;
+    avr_coro_resume(&consumer, NULL);
+}
@@ -0,0 +1,127 @@
+/*
+This example demonstrates how a chain of coroutines can process data
+in place by passing buffer descriptors from one stage to the other.
+
+The pipeline consists of three stages:
+
+1) reader() - takes a free buffer and fills it with a line of text
+received via serial port (the line terminator is not included).
+
+2) checksummer() - appends the sum of the bytes of the line as two hex
+digits to the end of the line, in place.
+
+3) printer() - prints the line and returns the buffer to the free
+list.
+
+There are only two buffers, so the reader waits when both of them
+are being processed by the other stages. The lines never get copied
+from one buffer to the other.
+
+When being uploaded to an Arduino board, this sketch echoes the lines
+sent to it (with a newline at the end) via serial port, e.g.:
+
+hello *14
+world *28
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 128
+#define BUFFERS 2
+#define BUFFER_SIZE 64
+#define STAGES 3
+
+static avr_pipe_t pipeline;
+static avr_pipe_stage_t stages[STAGES];
+static uint8_t stacks[STAGES][STACK_SIZE];
+static avr_buf_t buffers[BUFFERS];
+static uint8_t buffer_data[BUFFERS][BUFFER_SIZE];
+
+static void *reader(avr_coro_t *self, void *arg)
+{
+    avr_pipe_t *pipe = (avr_pipe_t *)arg;
+    for (;;)
+    {
+        avr_buf_t *buf = avr_pipe_alloc(pipe, self);
+        // leave room for the checksum
+        while (buf->len < buf->size - 4)
+        {
+            while (!Serial.available())
+            {
+                avr_coro_yield(self, NULL);
+            }
+            char c = Serial.read();
+            if (c == '\r' || c == '\n')
+            {
+                if (buf->len == 0)
+                {
+                    continue; // skip empty lines
+                }
+                break;
+            }
+            buf->datap[buf->len++] = c;
+        }
+        avr_pipe_send(pipe, self, buf);
+    }
+    return NULL;
+}
+
+static void *checksummer(avr_coro_t *self, void *arg)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    avr_pipe_t *pipe = (avr_pipe_t *)arg;
+    for (;;)
+    {
+        avr_buf_t *buf = avr_pipe_recv(pipe, self);
+        uint8_t sum = 0;
+        for (size_t i = 0; i < buf->len; i++)
+        {
+            sum += buf->datap[i];
+        }
+        buf->datap[buf->len++] = ' ';
+        buf->datap[buf->len++] = '*';
+        buf->datap[buf->len++] = hex[sum >> 4];
+        buf->datap[buf->len++] = hex[sum & 0x0F];
+        avr_pipe_send(pipe, self, buf);
+    }
+    return NULL;
+}
+
+static void *printer(avr_coro_t *self, void *arg)
+{
+    avr_pipe_t *pipe = (avr_pipe_t *)arg;
+    for (;;)
+    {
+        avr_buf_t *buf = avr_pipe_recv(pipe, self);
+        Serial.write(buf->datap, buf->len);
+        Serial.println();
+        avr_pipe_free(pipe, buf);
+    }
+    return NULL;
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_pipe_init(&pipeline, &stages[0], STAGES);
+    avr_pipe_stage_init(&pipeline, 0, &stacks[0][0], STACK_SIZE, reader);
+    avr_pipe_stage_init(&pipeline, 1, &stacks[1][0], STACK_SIZE, checksummer);
+    avr_pipe_stage_init(&pipeline, 2, &stacks[2][0], STACK_SIZE, printer);
+    for (uint8_t i = 0; i < BUFFERS; i++)
+    {
+        avr_pipe_add_buffer(&pipeline, &buffers[i], &buffer_data[i][0], BUFFER_SIZE);
+    }
+}
+
+void loop()
+{
+    avr_pipe_run(&pipeline);
+}
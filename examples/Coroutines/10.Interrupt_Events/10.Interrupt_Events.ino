@@ -0,0 +1,71 @@
+/*
+This example demonstrates how a coroutine can wait for an interrupt
+without polling.
+
+A button connected between the digital pin 2 and the ground triggers
+an external interrupt. The interrupt routine only signals an event by
+AVR_EVENT_SIGNAL. The button handler coroutine waits for the event,
+and loop() dispatches it: the coroutine gets resumed only when the
+event has been signalled, so the handler does not spend any CPU time
+checking the pin.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port every time the
+button gets pressed (the mechanical contacts of the button may
+bounce, so a single press may get counted more than once):
+
+button pressed: 1
+button pressed: 2
+button pressed: 3
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 128
+#define BUTTON_PIN 2
+
+static avr_coro_t handler;
+static uint8_t handler_stack[STACK_SIZE];
+static avr_event_t button_event;
+
+static void button_isr(void)
+{
+    AVR_EVENT_SIGNAL(&button_event);
+}
+
+static void *handler_func(avr_coro_t *self, void *)
+{
+    unsigned long presses = 0;
+    for (;;)
+    {
+        avr_event_wait(&button_event, self);
+        presses++;
+        Serial.print(F("button pressed: "));
+        Serial.println(presses);
+    }
+    return NULL;
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_event_init(&button_event);
+    avr_coro_init(&handler, &handler_stack[0], STACK_SIZE, handler_func);
+    // Run the handler until it waits for the event.
+    avr_coro_resume(&handler, NULL);
+    pinMode(BUTTON_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), button_isr, FALLING);
+}
+
+void loop()
+{
+    avr_event_dispatch(&button_event);
+}
@@ -0,0 +1,96 @@
+/*
+This example demonstrates how coroutines can sleep for a given number
+of ticks instead of checking millis() between the yields.
+
+There are three coroutines which print a message with different
+periods: 32, 64 and 96 ticks. The tick source is the watchdog timer in
+interrupt mode, it ticks approximately every 16 milliseconds. The
+timer interrupt routine calls avr_coro_sleep_tick(), which inspects
+only the head of the queue of sleeping coroutines. The loop() function
+resumes the coroutines which sleep has expired by calling
+avr_coro_sleep_dispatch().
+
+This example is meant to be run on the classic AVR devices (e.g.
+ATmega328P based Arduino boards).
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+coroutine 0 at 512 ms
+coroutine 0 at 1024 ms
+coroutine 1 at 1024 ms
+coroutine 0 at 1536 ms
+coroutine 2 at 1536 ms
+coroutine 0 at 2048 ms
+coroutine 1 at 2048 ms
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+#include <avr/wdt.h>
+
+#define STACK_SIZE 128
+#define COROUTINES 3
+
+static avr_coro_t coroutines[COROUTINES];
+static uint8_t stacks[COROUTINES][STACK_SIZE];
+static uint8_t numbers[COROUTINES];
+
+static void *periodic_func(avr_coro_t *self, void *arg)
+{
+    const uint8_t number = *(uint8_t *)arg;
+    const uint16_t period = 32 * (number + 1);
+    for (;;)
+    {
+        avr_coro_sleep_ticks(self, period);
+        Serial.print(F("coroutine "));
+        Serial.print(number);
+        Serial.print(F(" at "));
+        Serial.print(millis());
+        Serial.println(F(" ms"));
+    }
+    return NULL;
+}
+
+static void start_tick_timer(void)
+{
+    cli();
+    MCUSR &= ~(1 << WDRF);
+    wdt_reset();
+    // the interrupt mode only (no reset), the shortest period
+    WDTCSR |= 1 << WDCE | 1 << WDE;
+    WDTCSR = 1 << WDIE;
+    sei();
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    for (uint8_t i = 0; i < COROUTINES; i++)
+    {
+        void *data = &numbers[i];
+        numbers[i] = i;
+        avr_coro_init(&coroutines[i], &stacks[i][0], STACK_SIZE, periodic_func);
+        // Run the coroutine until it falls asleep.
+        avr_coro_resume(&coroutines[i], &data);
+    }
+    start_tick_timer();
+}
+
+void loop()
+{
+    avr_coro_sleep_dispatch();
+}
+
+// Tick Interrupt Service Routine.
+ISR(WDT_vect)
+{
+    avr_coro_sleep_tick();
+}
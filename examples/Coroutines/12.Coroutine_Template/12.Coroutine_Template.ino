@@ -0,0 +1,78 @@
+/*
+This example demonstrates the C++ wrapper of the coroutine facility
+(see avrcoro_cxx.h). The "avr::Coroutine" class template owns the
+coroutine stack and binds the coroutine function at compile time, so
+the coroutine gets defined with a single declaration and its function
+gets called directly.
+
+The coroutine yields the Fibonacci numbers which fit into 16 bits and
+returns. When it is dead, the main loop re-initialises it using the
+reset() member function and starts over.
+
+When being uploaded to an Arduino board, this sketch produces the
+following output via serial port (one number per half a second):
+
+0
+1
+1
+2
+3
+5
+...
+17711
+28657
+done
+0
+1
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+static void *fib_func(avr_coro_t *self, void *)
+{
+    uint16_t a = 0, b = 1;
+    for (;;)
+    {
+        void *data = (void *)&a;
+        avr_coro_yield(self, &data);
+        if (a > UINT16_MAX - b)
+        {
+            break; // the next number does not fit
+        }
+        uint16_t next = a + b;
+        a = b;
+        b = next;
+    }
+    return NULL; // the invoker gets NULL when the coroutine dies
+}
+
+// The stack is a member of the object, its size gets checked at
+// compile time.
+static avr::Coroutine<64, fib_func> fib;
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+}
+
+void loop() {
+    uint16_t *data = NULL;
+    fib.resume((void **)&data);
+    if (fib.state() == AVR_CORO_DEAD)
+    {
+        Serial.println("done");
+        fib.reset();
+    }
+    else
+    {
+        Serial.println(*data);
+    }
+    delay(500);
+}
@@ -0,0 +1,59 @@
+/*
+This example demonstrates the typed generators (see avrcoro_cxx.h).
+
+The generator decodes a string of hexadecimal digits and yields the
+decoded bytes one by one. Unlike in the Basic Generator example, the
+values do not have to live behind a pointer: every byte gets handed
+over to the invoker in place of the data pointer itself.
+
+The main loop consumes the generator using a range-based "for" loop,
+which runs until the generator function returns. After that the
+generator gets re-initialised using the reset() member function.
+
+When being uploaded to an Arduino board, this sketch prints the decoded
+message via serial port every one second:
+
+Hello, world!
+Hello, world!
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+static const char message[] = "48656C6C6F2C20776F726C6421";
+
+static uint8_t hex_digit(char c)
+{
+    return c <= '9' ? c - '0' : c - 'A' + 10;
+}
+
+static void decode(avr::Yield<uint8_t> &yield)
+{
+    for (const char *p = message; p[0] != '\0' && p[1] != '\0'; p += 2)
+    {
+        yield((uint8_t)((hex_digit(p[0]) << 4) | hex_digit(p[1])));
+    }
+}
+
+static avr::Generator<uint8_t, 64, decode> decoder;
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+}
+
+void loop() {
+    for (uint8_t byte : decoder)
+    {
+        Serial.write(byte);
+    }
+    Serial.println();
+    decoder.reset();
+    delay(1000);
+}
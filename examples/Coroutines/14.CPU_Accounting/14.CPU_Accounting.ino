@@ -0,0 +1,120 @@
+/*
+This example demonstrates how to find out which coroutine consumes
+the CPU time using the accounting statistics (see AVR_CONTEXT_STATS).
+
+There are two coroutines: the "busy" one calculates a checksum of a
+large buffer every time it gets resumed, while the "light" one only
+increments a counter. The main loop resumes both of them in turn and
+prints their statistics every second: the number of activations and
+the time they have been running for, in microseconds.
+
+The accounting is disabled by default, so the whole sketch (including
+the library) should be built with the AVR_CONTEXT_STATS macro defined
+to 1, e.g.:
+
+arduino-cli compile --build-property "compiler.cpp.extra_flags=-DAVR_CONTEXT_STATS=1" --build-property "compiler.c.extra_flags=-DAVR_CONTEXT_STATS=1" ...
+
+Otherwise, the sketch only prints a message saying so.
+
+The accounting clock is Timer1 running at clk/64, so this example is
+meant to be run on the classic AVR devices (e.g. ATmega328P based
+Arduino boards). Please keep in mind that the PWM on the pins driven
+by Timer1 does not work while it is free-running.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+busy: 2791 activations, 897801 us
+light: 2791 activations, 9769 us
+busy: 5580 activations, 1795134 us
+light: 5580 activations, 19530 us
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#if AVR_CONTEXT_STATS
+#define STACK_SIZE 96
+#define BUFFER_SIZE 512
+
+static avr_coro_t busy, light;
+static uint8_t busy_stack[STACK_SIZE], light_stack[STACK_SIZE];
+static uint8_t buffer[BUFFER_SIZE];
+static volatile uint16_t checksum, counter;
+
+static void *busy_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        uint16_t sum = 0;
+        for (uint16_t i = 0; i < BUFFER_SIZE; i++)
+        {
+            sum = (sum << 1 | sum >> 15) ^ buffer[i];
+        }
+        checksum = sum;
+        avr_coro_yield(self, NULL);
+    }
+    return NULL; // unreachable
+}
+
+static void *light_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        counter++;
+        avr_coro_yield(self, NULL);
+    }
+    return NULL; // unreachable
+}
+
+static void report(const char *name, const avr_coro_t *coro)
+{
+    avr_stats_t stats;
+    avr_coro_stats(coro, &stats);
+    Serial.print(name);
+    Serial.print(F(": "));
+    Serial.print(stats.switches);
+    Serial.print(F(" activations, "));
+    // a tick of the clock is 64 CPU cycles long
+    Serial.print((uint32_t)((uint64_t)stats.cycles * 64 * 1000000 / F_CPU));
+    Serial.println(F(" us"));
+}
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    // the free-running accounting clock: Timer1 at clk/64
+    TCCR1A = 0;
+    TCCR1B = 1 << CS11 | 1 << CS10;
+    TIMSK1 = 0;
+    avr_coro_init(&busy, &busy_stack[0], sizeof(busy_stack), busy_func);
+    avr_coro_init(&light, &light_stack[0], sizeof(light_stack), light_func);
+}
+
+void loop() {
+    static unsigned long last = millis();
+    avr_coro_resume(&busy, NULL);
+    avr_coro_resume(&light, NULL);
+    if (millis() - last >= 1000)
+    {
+        last = millis();
+        report("busy", &busy);
+        report("light", &light);
+    }
+}
+#else
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    Serial.println(F("Please rebuild this sketch (and the library) with -DAVR_CONTEXT_STATS=1."));
+}
+
+void loop() {
+}
+#endif /* AVR_CONTEXT_STATS */
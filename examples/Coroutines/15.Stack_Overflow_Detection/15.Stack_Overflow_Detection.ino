@@ -0,0 +1,104 @@
+/*
+This example demonstrates the stack overflow detection (see
+AVR_CONTEXT_STACK_CANARY).
+
+The coroutine has a deliberately small stack. Every time it gets
+resumed, it calls a recursive function one level deeper than before
+and yields from the deepest level. Sooner or later the stack gets
+overflowed, and the guard word at its low end gets overwritten. The
+guard word gets checked every time the coroutine yields, so the
+overflow gets detected right away, and the handler set by
+avr_stack_set_overflow_handler() gets called. The handler reports the
+overflow and halts the MCU.
+
+Please keep in mind that the detection happens after the fact: the
+memory right below the stack has been overwritten already, so in the
+real code the handler should do as little as possible (e.g. reset the
+MCU using the watchdog timer).
+
+The overflow detection is disabled by default, so the whole sketch
+(including the library) should be built with the
+AVR_CONTEXT_STACK_CANARY macro defined to 1, e.g.:
+
+arduino-cli compile --build-property "compiler.cpp.extra_flags=-DAVR_CONTEXT_STACK_CANARY=1" --build-property "compiler.c.extra_flags=-DAVR_CONTEXT_STACK_CANARY=1" ...
+
+Otherwise, the sketch only prints a message saying so.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+depth: 1
+depth: 2
+depth: 3
+...
+depth: 9
+stack overflow detected!
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#if AVR_CONTEXT_STACK_CANARY
+#define STACK_SIZE 96
+
+static avr_coro_t coro;
+static uint8_t stack[STACK_SIZE];
+
+static uint8_t descend(avr_coro_t *self, uint8_t depth)
+{
+    volatile uint8_t frame[4]; // make every level use some stack
+    frame[0] = depth;
+    if (depth > 1)
+    {
+        return descend(self, depth - 1) + frame[0];
+    }
+    avr_coro_yield(self, NULL);
+    return frame[0];
+}
+
+static void *coro_func(avr_coro_t *self, void *)
+{
+    for (uint8_t depth = 1;; depth++)
+    {
+        descend(self, depth);
+    }
+    return NULL; // unreachable
+}
+
+static void on_overflow(const void *)
+{
+    Serial.println(F("stack overflow detected!"));
+    Serial.flush();
+    cli();
+    for (;;);
+}
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    avr_stack_set_overflow_handler(on_overflow);
+    avr_coro_init(&coro, &stack[0], sizeof(stack), coro_func);
+}
+
+void loop() {
+    static uint8_t depth = 0;
+    avr_coro_resume(&coro, NULL);
+    Serial.print(F("depth: "));
+    Serial.println(++depth);
+    delay(500);
+}
+#else
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    Serial.println(F("Please rebuild this sketch (and the library) with -DAVR_CONTEXT_STACK_CANARY=1."));
+}
+
+void loop() {
+}
+#endif /* AVR_CONTEXT_STACK_CANARY */
@@ -0,0 +1,109 @@
+/*
+This example demonstrates the shared stack coroutines (see
+avrshared.h).
+
+There are COUNT coroutines which emulate the per-connection state
+machines: every coroutine waits for a few "packets" (resumptions),
+sums the data passed to it, and reports the result. All of them run
+on a single execution stack of STACK_SIZE bytes. Every coroutine has
+a save area of only SAVE_SIZE bytes, where the live part of its stack
+gets copied out when another coroutine takes the stack over.
+
+With dedicated stacks, the same number of coroutines would need
+COUNT * STACK_SIZE bytes of RAM for the stacks.
+
+After every round, the sketch prints the largest number of bytes
+copied out to a save area during the round, which shows how small the
+save areas could be.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+connection 0: sum 6
+connection 1: sum 9
+...
+connection 15: sum 51
+save area peak: 25 of 32 bytes
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define COUNT 16
+#define STACK_SIZE 256
+#define SAVE_SIZE 32
+#define PACKETS 3
+
+static avr_shared_stack_t shared_stack;
+static uint8_t stack[STACK_SIZE];
+static avr_shared_coro_t connections[COUNT];
+static uint8_t save_areas[COUNT][SAVE_SIZE];
+
+static void *connection_func(avr_coro_t *self, void *data)
+{
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < PACKETS; i++)
+    {
+        sum += (uint16_t)(uintptr_t)data;
+        if (i + 1 < PACKETS)
+        {
+            avr_coro_yield(self, &data); // wait for the next packet
+        }
+    }
+    return (void *)(uintptr_t)sum;
+}
+
+static void start_connections(void)
+{
+    avr_shared_stack_init(&shared_stack, &stack[0], sizeof(stack));
+    for (uint8_t i = 0; i < COUNT; i++)
+    {
+        avr_shared_coro_init(&connections[i], &shared_stack,
+                             &save_areas[i][0], sizeof(save_areas[i]),
+                             connection_func);
+    }
+}
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial);
+    start_connections();
+}
+
+void loop() {
+    size_t peak = 0;
+    // deliver the packets to the connections in turn
+    for (uint8_t packet = 0; packet < PACKETS; packet++)
+    {
+        for (uint8_t i = 0; i < COUNT; i++)
+        {
+            void *data = (void *)(uintptr_t)(i + packet + 1);
+            avr_shared_coro_resume(&connections[i], &data);
+            if (avr_coro_state(&connections[i].coro) == AVR_CORO_DEAD)
+            {
+                Serial.print(F("connection "));
+                Serial.print(i);
+                Serial.print(F(": sum "));
+                Serial.println((uint16_t)(uintptr_t)data);
+            }
+        }
+    }
+    for (uint8_t i = 0; i < COUNT; i++)
+    {
+        size_t n = avr_shared_coro_peak(&connections[i]);
+        peak = n > peak ? n : peak;
+    }
+    Serial.print(F("save area peak: "));
+    Serial.print(peak);
+    Serial.print(F(" of "));
+    Serial.print(SAVE_SIZE);
+    Serial.println(F(" bytes"));
+    start_connections();
+    delay(1000);
+}
@@ -0,0 +1,114 @@
+/*
+This example demonstrates the cooperative run queue scheduler.
+
+There are four worker coroutines and a producer coroutine. The workers
+wait for jobs on a wait queue, and the producer creates a job and
+wakes up a single worker on every activation. The scheduler resumes
+only the runnable coroutines: the workers which are waiting for a job
+do not get resumed at all, so every pass costs two activations instead
+of five. When the producer dies, loop() reaps it.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+pass 1: 5 of 5 resumed
+worker 0: job 1
+pass 2: 2 of 5 resumed
+worker 1: job 2
+pass 3: 2 of 5 resumed
+...
+worker 1: job 10
+pass 11: 2 of 5 resumed
+the producer has been reaped
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 128
+#define WORKERS 4
+#define JOBS 10
+
+static avr_coro_t workers[WORKERS];
+static uint8_t worker_stacks[WORKERS][STACK_SIZE];
+static avr_coro_t producer;
+static uint8_t producer_stack[STACK_SIZE];
+static avr_waitq_t job_queue;
+static uint8_t jobs_pending;
+static uint8_t jobs_created;
+static uint8_t pass;
+
+static void *worker_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        while (jobs_pending == 0)
+        {
+            avr_runq_wait(self, &job_queue);
+        }
+        jobs_pending--;
+        Serial.print(F("worker "));
+        Serial.print(self - &workers[0]);
+        Serial.print(F(": job "));
+        Serial.println(jobs_created - jobs_pending);
+    }
+    return NULL;
+}
+
+static void *producer_func(avr_coro_t *self, void *)
+{
+    while (jobs_created < JOBS)
+    {
+        jobs_created++;
+        jobs_pending++;
+        avr_runq_wake(&job_queue);
+        avr_coro_yield(self, NULL);
+    }
+    return NULL;
+}
+
+void setup()
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_waitq_init(&job_queue);
+    for (uint8_t i = 0; i < WORKERS; i++)
+    {
+        avr_coro_init(&workers[i], &worker_stacks[i][0], STACK_SIZE, worker_func);
+        avr_runq_add(&workers[i]);
+    }
+    avr_coro_init(&producer, &producer_stack[0], STACK_SIZE, producer_func);
+    avr_runq_add(&producer);
+}
+
+void loop()
+{
+    uint8_t resumed;
+    avr_coro_t *dead;
+    if (avr_runq_empty())
+    {
+        // Only the waiting workers are left.
+        return;
+    }
+    resumed = avr_runq_run();
+    pass++;
+    Serial.print(F("pass "));
+    Serial.print(pass);
+    Serial.print(F(": "));
+    Serial.print(resumed);
+    Serial.print(F(" of "));
+    Serial.print(WORKERS + 1);
+    Serial.println(F(" resumed"));
+    while ((dead = avr_runq_reap()) != NULL)
+    {
+        if (dead == &producer)
+        {
+            Serial.println(F("the producer has been reaped"));
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*
+This example demonstrates how the coroutine drivers can be used.
+
+There are two coroutines. The scanner coroutine looks for the devices
+on the I2C bus every five seconds and reports their addresses. The
+echo coroutine sends back every byte received via serial port. Both
+of them use the UART driver for output: if one of them is sending a
+message, the other one waits until it is done. Neither of them
+busy-waits for the hardware: while a transfer is in progress, the
+coroutine yields, so loop() keeps resuming both of them in turns.
+
+The interrupt routines of the drivers get defined by the AVR_UART_ISR
+and AVR_TWI_ISR macros. The Arduino Serial and Wire objects are not
+used, as they define the same interrupt routines.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port every five seconds
+(the addresses depend on the devices connected to the bus):
+
+device at 0x3C
+device at 0x68
+scan done: 2 devices
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 160
+#define SCAN_PERIOD 5000
+
+static avr_coro_t scanner;
+static uint8_t scanner_stack[STACK_SIZE];
+static avr_coro_t echo;
+static uint8_t echo_stack[STACK_SIZE];
+
+AVR_UART_ISR()
+AVR_TWI_ISR()
+
+static void uart_print(avr_coro_t *self, const char *str)
+{
+    avr_uart_write(self, str, strlen(str));
+}
+
+static char *format_hex(char *p, uint8_t value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    *p++ = '0';
+    *p++ = 'x';
+    *p++ = digits[value >> 4];
+    *p++ = digits[value & 0x0F];
+    return p;
+}
+
+static void *scanner_func(avr_coro_t *self, void *)
+{
+    char msg[24];
+    for (;;)
+    {
+        uint8_t found = 0;
+        unsigned long start = millis();
+        for (uint8_t addr = 0x08; addr < 0x78; addr++)
+        {
+            // An empty write only checks if the device responds.
+            if (avr_twi_write(self, addr, NULL, 0) == 0)
+            {
+                char *p = format_hex(&msg[0], addr);
+                *p = '\0';
+                uart_print(self, "device at ");
+                uart_print(self, msg);
+                uart_print(self, "\r\n");
+                found++;
+            }
+        }
+        utoa(found, msg, 10);
+        uart_print(self, "scan done: ");
+        uart_print(self, msg);
+        uart_print(self, " devices\r\n");
+        while (millis() - start < SCAN_PERIOD)
+        {
+            avr_coro_yield(self, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void *echo_func(avr_coro_t *self, void *)
+{
+    for (;;)
+    {
+        uint8_t c;
+        avr_uart_read(self, &c, 1);
+        avr_uart_write(self, &c, 1);
+    }
+    return NULL;
+}
+
+void setup()
+{
+    // Enable the internal pull-ups of the I2C lines.
+    pinMode(SDA, INPUT_PULLUP);
+    pinMode(SCL, INPUT_PULLUP);
+    avr_uart_init(9600);
+    avr_twi_init(100000);
+    avr_coro_init(&scanner, &scanner_stack[0], STACK_SIZE, scanner_func);
+    avr_coro_init(&echo, &echo_stack[0], STACK_SIZE, echo_func);
+}
+
+void loop()
+{
+    avr_coro_resume(&scanner, NULL);
+    avr_coro_resume(&echo, NULL);
+}
@@ -0,0 +1,95 @@
+/*
+This example demonstrates how the preemptive priority based task
+scheduler can be used.
+
+There are three tasks:
+
+1) loop() - the initial execution context of the MCU converted into a
+task with priority 1. It counts its iterations and, every 100000
+iterations, resumes the reporter task.
+
+2) counter_task() - the other task with priority 1. It counts its
+iterations as well. As it has the same priority as loop(), they get
+switched in Round Robin fashion on every tick.
+
+3) reporter_task() - the task with priority 2. It prints both
+counters and suspends itself, thus, loop() and counter_task() get
+their CPU time back. As its priority is higher, it gets activated
+right at the moment when loop() resumes it.
+
+System timer is implemented on top of the default tick source of the
+scheduler (Timer2 on the classic AVR devices, TCB0 on the megaAVR
+ones), it ticks every millisecond. See AVR_SCHED_TICK_SOURCE and
+AVR_SCHED_TICK_HZ in avrsched.h.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+loop: 100000, counter: 98304
+loop: 200000, counter: 197632
+loop: 300000, counter: 296960
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 160
+
+static avr_task_t main_task, counter, reporter;
+static uint8_t counter_stack[STACK_SIZE], reporter_stack[STACK_SIZE];
+static volatile uint32_t loop_iterations, counter_iterations;
+
+static void counter_task(void *)
+{
+    for (;;)
+    {
+        counter_iterations++;
+    }
+}
+
+static void reporter_task(void *)
+{
+    for (;;)
+    {
+        Serial.print(F("loop: "));
+        Serial.print(loop_iterations);
+        Serial.print(F(", counter: "));
+        Serial.println(counter_iterations);
+        avr_task_suspend(&reporter); // until loop() resumes us
+    }
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+    // Convert the currently running code into a task.
+    avr_sched_init(&main_task, 1);
+    avr_task_init(&counter,
+                  &counter_stack[0], sizeof(counter_stack),
+                  1, counter_task, NULL);
+    avr_task_init(&reporter,
+                  &reporter_stack[0], sizeof(reporter_stack),
+                  2, reporter_task, NULL);
+    // Suspend the reporter for now. It gets resumed by loop().
+    avr_task_suspend(&reporter);
+    avr_sched_tick_start();
+}
+
+void loop(void)
+{
+    loop_iterations++;
+    if (loop_iterations % 100000 == 0)
+    {
+        avr_task_resume(&reporter); // switches to the reporter immediately
+    }
+}
+
+// System Timer Interrupt System Routine.
+AVR_SCHED_TICK_ISR()
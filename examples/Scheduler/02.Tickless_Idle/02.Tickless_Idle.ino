@@ -0,0 +1,77 @@
+/*
+This example demonstrates how the tasks can be delayed and how the
+scheduler puts the MCU to sleep when all of them are blocked.
+
+There are two tasks:
+
+1) loop() - the initial execution context of the MCU converted into a
+task with priority 1. It toggles the built-in LED and delays itself
+for 500 ticks.
+
+2) reporter_task() - the task with priority 2. It prints the tick
+count every 2000 ticks.
+
+Most of the time neither of the tasks is ready. In this case the
+scheduler activates its idle task, which stops the periodic tick and
+puts the MCU to sleep until the earliest of the tasks should wake up
+(see AVR_SCHED_TICKLESS and AVR_SCHED_SLEEP_MODE in avrsched.h). With
+the default tick source (Timer2 on the classic AVR devices, TCB0 on
+the megaAVR ones) the MCU wakes up at least every 16 (or 8) ticks
+instead of every tick. Please keep in mind that the Arduino core
+keeps the Timer0 interrupt (millis()) running: it wakes the MCU up as
+well, but the idle task just goes back to sleep.
+
+When being uploaded to an Arduino board, this sketch blinks the
+built-in LED and produces the following (or very similar) output via
+serial port:
+
+ticks: 2000
+ticks: 4000
+ticks: 6000
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 160
+
+static avr_task_t main_task, reporter;
+static uint8_t reporter_stack[STACK_SIZE];
+
+static void reporter_task(void *)
+{
+    for (;;)
+    {
+        avr_task_delay(2000);
+        Serial.print(F("ticks: "));
+        Serial.println(avr_sched_tick_count());
+    }
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+    pinMode(LED_BUILTIN, OUTPUT);
+    // Convert the currently running code into a task.
+    avr_sched_init(&main_task, 1);
+    avr_task_init(&reporter,
+                  &reporter_stack[0], sizeof(reporter_stack),
+                  2, reporter_task, NULL);
+    avr_sched_tick_start();
+}
+
+void loop(void)
+{
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+    avr_task_delay(500);
+}
+
+// System Timer Interrupt System Routine.
+AVR_SCHED_TICK_ISR()
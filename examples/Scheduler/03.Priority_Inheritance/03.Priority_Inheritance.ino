@@ -0,0 +1,118 @@
+/*
+This example demonstrates how a mutex prevents priority inversion.
+
+There are three tasks sharing the CPU in rounds of 200 ticks:
+
+1) loop() - the initial execution context of the MCU converted into a
+task with priority 1. At the beginning of every round, it locks the
+mutex which guards a shared "bus" and keeps it for 20 ticks.
+
+2) medium_task() - the task with priority 2. It wakes up 5 ticks into
+the round and keeps the CPU busy for 50 ticks without touching the
+bus.
+
+3) high_task() - the task with priority 3. It wakes up 10 ticks into
+the round, locks the mutex, and reports how long it has waited for it.
+
+Without priority inheritance, medium_task() would preempt loop() while
+it owns the mutex, so high_task() would wait until medium_task() is
+done (about 45 ticks). As high_task() waits for the mutex, loop()
+inherits its priority and finishes its work in spite of
+medium_task(), so high_task() gets the mutex after 10 ticks.
+
+When being uploaded to an Arduino board, this sketch produces the
+following (or very similar) output via serial port:
+
+high: waited 10 ticks, loop() was running at priority 3
+high: waited 10 ticks, loop() was running at priority 3
+high: waited 10 ticks, loop() was running at priority 3
+...
+
+***
+  Author: Artem Boldariev <artem@boldariev.com>
+  This example code is in the public domain.
+
+  See UNLICENSE.txt in the examples directory for license details.
+*/
+
+#include <avrcontext_arduino.h>
+
+#define STACK_SIZE 160
+#define ROUND_TICKS 200
+
+static avr_task_t main_task, medium, high;
+static uint8_t medium_stack[STACK_SIZE], high_stack[STACK_SIZE];
+static avr_mutex_t bus;
+static uint32_t first_round;
+static volatile uint8_t loop_priority;
+
+static void delay_until(uint32_t tick)
+{
+    uint32_t now = avr_sched_tick_count();
+    if ((int32_t)(tick - now) > 0)
+    {
+        avr_task_delay(tick - now);
+    }
+}
+
+static void busy_until(uint32_t tick)
+{
+    while ((int32_t)(tick - avr_sched_tick_count()) > 0);
+}
+
+static void medium_task(void *)
+{
+    for (uint32_t round = first_round;; round += ROUND_TICKS)
+    {
+        delay_until(round + 5);
+        busy_until(round + 55);
+    }
+}
+
+static void high_task(void *)
+{
+    for (uint32_t round = first_round;; round += ROUND_TICKS)
+    {
+        uint32_t start, waited;
+        delay_until(round + 10);
+        start = avr_sched_tick_count();
+        avr_mutex_lock(&bus);
+        waited = avr_sched_tick_count() - start;
+        avr_mutex_unlock(&bus);
+        Serial.print(F("high: waited "));
+        Serial.print(waited);
+        Serial.print(F(" ticks, loop() was running at priority "));
+        Serial.println(loop_priority);
+    }
+}
+
+void setup(void)
+{
+    Serial.begin(9600);
+    while (!Serial);
+    avr_mutex_init(&bus);
+    // Convert the currently running code into a task.
+    avr_sched_init(&main_task, 1);
+    avr_sched_tick_start();
+    first_round = avr_sched_tick_count() + 10;
+    avr_task_init(&medium,
+                  &medium_stack[0], sizeof(medium_stack),
+                  2, medium_task, NULL);
+    avr_task_init(&high,
+                  &high_stack[0], sizeof(high_stack),
+                  3, high_task, NULL);
+}
+
+void loop(void)
+{
+    static uint32_t round = first_round;
+    delay_until(round);
+    avr_mutex_lock(&bus);
+    busy_until(round + 20); // "uses the bus"
+    loop_priority = avr_task_priority(&main_task);
+    avr_mutex_unlock(&bus);
+    round += ROUND_TICKS;
+}
+
+// System Timer Interrupt System Routine.
+AVR_SCHED_TICK_ISR()